@@ -0,0 +1,27 @@
+// construction of the backend problem over a window of keyframes by Backend::AddKeyframe,
+// with the flat visual::Features of lvio_fusion against the node based ones of lvio_fusion_node_features.
+#include "bench.h"
+
+// in backend_construction.cpp, compiled against each library
+namespace lvio_fusion
+{
+double time_problem_construction(int n, int &num_blocks);
+}
+
+namespace lvio_fusion_node_features
+{
+double time_problem_construction(int n, int &num_blocks);
+}
+
+using namespace lvio_fusion;
+
+int main(int argc, char **argv)
+{
+    int n = 20, num_node, num_flat;
+    double t_node = lvio_fusion_node_features::time_problem_construction(n, num_node);
+    double t_flat = lvio_fusion::time_problem_construction(n, num_flat);
+    bool ok = bench::check(num_flat == num_node, "the same residual blocks are built");
+    std::cout << num_flat << " residual blocks" << std::endl;
+    bench::report("problem construction, std::map -> flat features", t_node, t_flat);
+    return ok ? 0 : 1;
+}
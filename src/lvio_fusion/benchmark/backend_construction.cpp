@@ -0,0 +1,88 @@
+// the backend problem over a window of keyframes, built by Backend::AddKeyframe.
+// backend_bench compiles it twice, against lvio_fusion and against lvio_fusion_node_features,
+// in which the namespace is renamed and visual::Features is node based.
+#include "bench.h"
+#include "lvio_fusion/backend.h"
+#include "lvio_fusion/frame.h"
+#include "lvio_fusion/visual/camera.h"
+#include "lvio_fusion/visual/landmark.h"
+
+#include <random>
+
+namespace lvio_fusion
+{
+
+const int num_keyframes = 12; // the first two are before the window
+const int num_features = 300; // new landmarks of a keyframe
+const int num_observed = 4;   // keyframes observing a landmark
+
+// features only hold weak pointers of landmarks, which are owned by the map
+std::vector<Frame::Ptr> create_keyframes(std::vector<visual::Landmark::Ptr> &landmarks)
+{
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::vector<Frame::Ptr> keyframes;
+    for (int i = 0; i < num_keyframes; i++)
+    {
+        Frame::Ptr frame = Frame::Create();
+        frame->id = i + 1;
+        frame->time = i * 0.5;
+        frame->pose = SE3d(Quaterniond::Identity(), Vector3d(0, 0, i * 5.0));
+        keyframes.push_back(frame);
+    }
+    for (int i = 0; i < num_keyframes; i++)
+    {
+        for (int j = 0; j < num_features; j++)
+        {
+            cv::KeyPoint kp(u(gen) * 1241, u(gen) * 376, 31);
+            auto landmark = visual::Landmark::Create(1 / (5 + 50 * u(gen)));
+            landmarks.push_back(landmark);
+            auto right = visual::Feature::Create(keyframes[i], cv::KeyPoint(kp.pt.x - 20, kp.pt.y, 31), landmark);
+            right->is_on_left_image = false;
+            for (int k = i; k < std::min(i + num_observed, num_keyframes); k++)
+            {
+                auto feature = visual::Feature::Create(keyframes[k], kp, landmark);
+                keyframes[k]->AddFeature(feature);
+                landmark->AddObservation(feature);
+            }
+            keyframes[i]->AddFeature(right);
+            landmark->AddObservation(right);
+        }
+    }
+    return keyframes;
+}
+
+class BackendBench
+{
+public:
+    // a new problem of the window, as the backend builds it after a reset
+    static int BuildProblem(Backend &backend, const std::vector<Frame::Ptr> &keyframes)
+    {
+        ceres::Problem::Options options;
+        options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+        options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+        options.enable_fast_removal = true;
+        adapt::Problem problem(options);
+        std::map<double, Backend::KeyframeResiduals> residuals;
+        double start_time = keyframes[2]->time;
+        for (int i = 2; i < num_keyframes; i++)
+        {
+            backend.AddKeyframe(keyframes[i], keyframes[i - 1], start_time, problem, residuals[keyframes[i]->time]);
+        }
+        return problem.NumResidualBlocks();
+    }
+};
+
+double time_problem_construction(int n, int &num_blocks)
+{
+    Camera::Create(718.856, 718.856, 607.1928, 185.2157, SE3d());
+    Camera::Create(718.856, 718.856, 607.1928, 185.2157, SE3d(Quaterniond::Identity(), Vector3d(-0.537, 0, 0)));
+    std::vector<visual::Landmark::Ptr> landmarks;
+    std::vector<Frame::Ptr> keyframes = create_keyframes(landmarks);
+    // threads of the backend never exit, so it is never destroyed
+    Backend *backend = new Backend(5, false, false);
+    num_blocks = BackendBench::BuildProblem(*backend, keyframes);
+    return bench::time_us(n, [&]() { BackendBench::BuildProblem(*backend, keyframes); });
+}
+
+} // namespace lvio_fusion
@@ -0,0 +1,43 @@
+#ifndef lvio_fusion_BENCH_H
+#define lvio_fusion_BENCH_H
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+
+namespace lvio_fusion
+{
+
+namespace bench
+{
+
+// average microseconds of a run, after one run to warm up
+inline double time_us(int n, const std::function<void()> &body)
+{
+    body();
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        body();
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(t2 - t1).count() / n;
+}
+
+inline bool check(bool ok, const std::string &what)
+{
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << what << std::endl;
+    return ok;
+}
+
+inline void report(const std::string &what, double before_us, double after_us)
+{
+    std::cout << what << ": " << before_us << " us -> " << after_us << " us, x" << before_us / after_us << std::endl;
+}
+
+} // namespace bench
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_BENCH_H
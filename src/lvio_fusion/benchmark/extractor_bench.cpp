@@ -0,0 +1,105 @@
+// ORB detection: parallel FAST/quadtree and SSE orientation against one thread and the scalar IC angle.
+// usage: extractor_bench [image]
+#include "bench.h"
+#include "image.h"
+#include "lvio_fusion/visual/extractor.h"
+
+using namespace lvio_fusion;
+
+// IC_Angle of ORB_SLAM2
+float ic_angle(const cv::Mat &image, cv::Point2f pt, const std::vector<int> &umax, int half_patch_size)
+{
+    int m_01 = 0, m_10 = 0;
+    const uchar *center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+    for (int u = -half_patch_size; u <= half_patch_size; ++u)
+        m_10 += u * center[u];
+    int step = (int)image.step1();
+    for (int v = 1; v <= half_patch_size; ++v)
+    {
+        int v_sum = 0;
+        int d = umax[v];
+        for (int u = -d; u <= d; ++u)
+        {
+            int val_plus = center[u + v * step], val_minus = center[u - v * step];
+            v_sum += (val_plus - val_minus);
+            m_10 += u * (val_plus + val_minus);
+        }
+        m_01 += v * v_sum;
+    }
+    return cv::fastAtan2((float)m_01, (float)m_10);
+}
+
+std::vector<int> compute_umax(int half_patch_size)
+{
+    std::vector<int> umax(half_patch_size + 1);
+    int v, v0, vmax = cvFloor(half_patch_size * sqrt(2.f) / 2 + 1);
+    int vmin = cvCeil(half_patch_size * sqrt(2.f) / 2);
+    const double hp2 = half_patch_size * half_patch_size;
+    for (v = 0; v <= vmax; ++v)
+        umax[v] = cvRound(sqrt(hp2 - v * v));
+    for (v = half_patch_size, v0 = 0; v >= vmin; --v)
+    {
+        while (umax[v0] == umax[v0 + 1])
+            ++v0;
+        umax[v] = v0;
+        ++v0;
+    }
+    return umax;
+}
+
+bool same_keypoints(const std::vector<std::vector<cv::KeyPoint>> &a, const std::vector<std::vector<cv::KeyPoint>> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int level = 0; level < a.size(); level++)
+    {
+        if (a[level].size() != b[level].size())
+            return false;
+        for (int i = 0; i < a[level].size(); i++)
+        {
+            const cv::KeyPoint &p = a[level][i], &q = b[level][i];
+            if (p.pt != q.pt || p.angle != q.angle || p.response != q.response || p.octave != q.octave)
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    cv::Mat image = argc > 1 ? cv::imread(argv[1], cv::IMREAD_GRAYSCALE) : bench::synthetic_image();
+    if (image.empty())
+    {
+        std::cerr << "can not read " << argv[1] << std::endl;
+        return 1;
+    }
+
+    Extractor extractor;
+    ImagePyramid pyramid;
+    std::vector<std::vector<cv::KeyPoint>> kps_serial, kps_parallel;
+    int num_threads = cv::getNumThreads();
+
+    cv::setNumThreads(1);
+    double serial = bench::time_us(20, [&] { extractor.Detect(image, pyramid, kps_serial); });
+    cv::setNumThreads(num_threads);
+    double parallel = bench::time_us(20, [&] { extractor.Detect(image, pyramid, kps_parallel); });
+    bench::report("Detect, 1 -> " + std::to_string(num_threads) + " threads", serial, parallel);
+
+    bool ok = bench::check(same_keypoints(kps_serial, kps_parallel), "keypoints are independent of threads");
+
+    // orientations against the scalar IC angle, at the coordinates of their levels
+    std::vector<int> umax = compute_umax(extractor.half_patch_size);
+    int num = 0, wrong = 0;
+    double scale = 1;
+    for (int level = 0; level < kps_parallel.size(); level++, scale *= extractor.scale_factor)
+    {
+        for (auto &kp : kps_parallel[level])
+        {
+            cv::Point2f pt(cvRound(kp.pt.x / scale), cvRound(kp.pt.y / scale));
+            wrong += ic_angle(pyramid.images[level], pt, umax, extractor.half_patch_size) != kp.angle;
+            num++;
+        }
+    }
+    ok &= bench::check(num > 0 && wrong == 0, std::to_string(num - wrong) + "/" + std::to_string(num) + " angles equal to the scalar IC angle");
+    return ok ? 0 : 1;
+}
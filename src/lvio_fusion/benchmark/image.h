@@ -0,0 +1,40 @@
+#ifndef lvio_fusion_BENCH_IMAGE_H
+#define lvio_fusion_BENCH_IMAGE_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+namespace bench
+{
+
+// textured image of the size of KITTI, blurred noise and random boxes
+inline cv::Mat synthetic_image(int seed = 1)
+{
+    cv::Mat image(376, 1241, CV_8UC1);
+    cv::RNG rng(seed);
+    rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(image, image, cv::Size(9, 9), 3);
+    for (int i = 0; i < 300; i++)
+    {
+        cv::Point corner(rng.uniform(0, image.cols), rng.uniform(0, image.rows));
+        cv::rectangle(image, corner, corner + cv::Point(rng.uniform(5, 40), rng.uniform(5, 40)), cv::Scalar(rng.uniform(0, 256)), -1);
+    }
+    return image;
+}
+
+// the image shifted by (dx, dy), the border is reflected
+inline cv::Mat shift_image(const cv::Mat &image, float dx, float dy)
+{
+    cv::Mat shifted;
+    cv::Mat M = (cv::Mat_<float>(2, 3) << 1, 0, dx, 0, 1, dy);
+    cv::warpAffine(image, shifted, M, image.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT_101);
+    return shifted;
+}
+
+} // namespace bench
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_BENCH_IMAGE_H
@@ -0,0 +1,102 @@
+// KLT with the adapted window against optical_flow() (cv::calcOpticalFlowPyrLK, 21x21, 3 levels, and tracking back),
+// on the same points of shifts of a synthetic image. predictions have an error of about 0.25 * motion + 0.5 pixels.
+// TrackLastFrame predicts the points unless the frontend is reset, so the predicted cases decide the speedup.
+#include "bench.h"
+#include "image.h"
+#include "lvio_fusion/utility.h"
+#include "lvio_fusion/visual/klt.h"
+
+using namespace lvio_fusion;
+
+// rate of points tracked within 1 pixel of the truth, and passing the check
+double correct_rate(const std::vector<cv::Point2f> &pts, const std::vector<cv::Point2f> &truth, const std::vector<uchar> &status)
+{
+    int n = 0;
+    for (int i = 0; i < pts.size(); i++)
+    {
+        n += status[i] && cv::norm(pts[i] - truth[i]) < 1;
+    }
+    return (double)n / pts.size();
+}
+
+// rate of points passing the check, the inliers of TrackLastFrame
+double inlier_rate(const std::vector<uchar> &status)
+{
+    return (double)std::count(status.begin(), status.end(), 1) / status.size();
+}
+
+int main()
+{
+    cv::Mat image = bench::synthetic_image();
+    std::vector<cv::Point2f> corners, prev_pts;
+    cv::goodFeaturesToTrack(image, corners, 300, 0.01, 10);
+    for (auto &pt : corners)
+    {
+        if (pt.x > 50 && pt.x < image.cols - 50 && pt.y > 50 && pt.y < image.rows - 50)
+        {
+            prev_pts.push_back(pt);
+        }
+    }
+    std::vector<cv::Mat> prev_pyramid, next_pyramid;
+    build_optical_flow_pyramid(image, prev_pyramid);
+
+    cv::RNG rng(2);
+    bool ok = true;
+    const int num_trials = 10;
+    double time_base_predicted = 0, time_klt_predicted = 0;
+    for (double motion : {0., 2., 5., 8., 12., 20., 30.})
+    {
+        // predicted and not predicted
+        for (bool predicted : {true, false})
+        {
+            double rate_base = 0, rate_klt = 0, inliers_base = 0, inliers_klt = 0, time_base = 0, time_klt = 0;
+            for (int trial = 0; trial < num_trials; trial++)
+            {
+                double angle = rng.uniform(0., 2 * CV_PI);
+                cv::Point2f d(motion * cos(angle), motion * sin(angle));
+                build_optical_flow_pyramid(bench::shift_image(image, d.x, d.y), next_pyramid);
+                std::vector<cv::Point2f> truth, guess;
+                for (auto &pt : prev_pts)
+                {
+                    truth.push_back(pt + d);
+                    double sigma = 0.25 * motion + 0.5;
+                    guess.push_back(predicted ? truth.back() + cv::Point2f(rng.gaussian(sigma), rng.gaussian(sigma)) : pt);
+                }
+
+                std::vector<cv::Point2f> pts_base = guess, pts_klt = guess;
+                std::vector<uchar> status_base, status_klt;
+                time_base += bench::time_us(3, [&] {
+                    pts_base = guess;
+                    optical_flow(prev_pyramid, next_pyramid, prev_pts, pts_base, status_base);
+                });
+                KLT klt = predicted ? KLT::Adapt(motion) : KLT();
+                time_klt += bench::time_us(3, [&] {
+                    pts_klt = guess;
+                    klt.Track(prev_pyramid, next_pyramid, prev_pts, pts_klt, status_klt);
+                });
+                rate_base += correct_rate(pts_base, truth, status_base);
+                rate_klt += correct_rate(pts_klt, truth, status_klt);
+                inliers_base += inlier_rate(status_base);
+                inliers_klt += inlier_rate(status_klt);
+            }
+            rate_base /= num_trials;
+            rate_klt /= num_trials;
+            inliers_base /= num_trials;
+            inliers_klt /= num_trials;
+            if (predicted)
+            {
+                time_base_predicted += time_base;
+                time_klt_predicted += time_klt;
+            }
+            std::cout << motion << " px, " << (predicted ? "predicted" : "not predicted") << ": correct "
+                      << rate_base << " -> " << rate_klt << ", inliers " << inliers_base << " -> " << inliers_klt << ", ";
+            bench::report("time", time_base / num_trials, time_klt / num_trials);
+            ok &= bench::check(rate_klt >= rate_base - 0.02, "KLT tracks as many points as optical_flow()");
+            ok &= bench::check(inliers_klt >= inliers_base - 0.02, "KLT keeps as many inliers as optical_flow()");
+            ok &= bench::check(time_klt <= time_base, "KLT is not slower than optical_flow()");
+        }
+    }
+    bench::report("predicted flow of TrackLastFrame", time_base_predicted, time_klt_predicted);
+    ok &= bench::check(time_klt_predicted * 2 <= time_base_predicted, "KLT takes at most half the time of optical_flow()");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// point-to-plane errors of a scan in one batched residual block, against one autodiff block per point,
+// with the subsets of rpyxyz and the huber losses of ScanToMapWithGround and ScanToMapWithSegmented.
+#include "bench.h"
+#include "lvio_fusion/ceres/lidar_error.hpp"
+#include "lvio_fusion/utility.h"
+
+#include <random>
+
+using namespace lvio_fusion;
+
+const int num_points = 2000; // correspondences of a scan
+const double noise = 0.2;    // meters, off the planes
+
+// the per-point error which the batch replaces, 3 of rpyxyz are parameters
+class LidarPlanePointError
+{
+public:
+    LidarPlanePointError(Vector3d p, Vector3d pa, Vector3d pb, Vector3d pc, SE3d Twc1, double *rpyxyz, int i0, int i1, int i2, double weight)
+        : p_(p), pa_(pa), Twc1_(Twc1), rpyxyz_(rpyxyz), indices_{i0, i1, i2}, weight_(weight)
+    {
+        abc_norm_ = (pa_ - pb).cross(pa_ - pc);
+        abc_norm_.normalize();
+    }
+
+    template <typename T>
+    bool operator()(const T *x0, const T *x1, const T *x2, T *residual) const
+    {
+        T Twc1[7], Twc2[7], relative_i_j[7], rpyxyz[6];
+        ceres::Cast(rpyxyz_, 6, rpyxyz);
+        rpyxyz[indices_[0]] = *x0;
+        rpyxyz[indices_[1]] = *x1;
+        rpyxyz[indices_[2]] = *x2;
+        ceres::RpyxyzToSE3(rpyxyz, relative_i_j);
+        ceres::Cast(Twc1_.data(), SE3d::num_parameters, Twc1);
+        ceres::SE3Product(Twc1, relative_i_j, Twc2);
+        T cp[3] = {T(p_.x()), T(p_.y()), T(p_.z())};
+        T pa[3] = {T(pa_.x()), T(pa_.y()), T(pa_.z())};
+        T abc_norm[3] = {T(abc_norm_.x()), T(abc_norm_.y()), T(abc_norm_.z())};
+        T lp[3], lp_pa[3];
+        ceres::SE3TransformPoint(Twc2, cp, lp);
+        ceres::Minus(lp, pa, lp_pa);
+        residual[0] = T(weight_) * ceres::DotProduct(lp_pa, abc_norm);
+        return true;
+    }
+
+private:
+    Vector3d p_, pa_, abc_norm_;
+    SE3d Twc1_;
+    double *rpyxyz_;
+    int indices_[3];
+    double weight_;
+};
+
+struct Scan
+{
+    std::string name;
+    int indices[3];
+    double huber;
+    std::unique_ptr<LidarPlaneBatchError> batch;
+    std::vector<std::unique_ptr<ceres::CostFunction>> points;
+    std::unique_ptr<ceres::LossFunction> loss;
+};
+
+// points of the current scan on planes of the map, moved off them by noise
+void create_scan(Scan &scan, const SE3d &Twc1, double *rpyxyz, const SE3d &Twc2, int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> u(-1, 1);
+    std::normal_distribution<double> n(0, noise);
+    scan.batch.reset(new LidarPlaneBatchError(Twc1, rpyxyz, scan.indices[0], scan.indices[1], scan.indices[2], scan.huber));
+    if (scan.huber > 0)
+    {
+        scan.loss.reset(new ceres::HuberLoss(scan.huber));
+    }
+    for (int i = 0; i < num_points; i++)
+    {
+        Vector3d p(30 * u(gen), 30 * u(gen), 2 * u(gen));
+        Vector3d normal = Vector3d(u(gen), u(gen), u(gen)).normalized();
+        Vector3d x = normal.unitOrthogonal(), y = normal.cross(x);
+        Vector3d pw = Twc2 * p + n(gen) * normal;
+        Vector3d pa = pw + 0.3 * u(gen) * x + 0.3 * u(gen) * y,
+                 pb = pw + 0.3 * u(gen) * x + 0.3 * u(gen) * y,
+                 pc = pw + 0.3 * u(gen) * x + 0.3 * u(gen) * y;
+        double weight = 1 + 0.5 * u(gen);
+        scan.batch->Add(p, pa, pb, pc, weight);
+        scan.points.emplace_back(new ceres::AutoDiffCostFunction<LidarPlanePointError, 1, 1, 1, 1>(
+            new LidarPlanePointError(p, pa, pb, pc, Twc1, rpyxyz, scan.indices[0], scan.indices[1], scan.indices[2], weight)));
+    }
+}
+
+// cost and gradient as ceres sees them, which a loss function scales by rho
+double evaluate_points(const Scan &scan, double const *const *parameters, Vector3d &gradient)
+{
+    double cost = 0, residual, jacobians[3];
+    double *ptr[3] = {jacobians, jacobians + 1, jacobians + 2};
+    gradient.setZero();
+    for (auto &point : scan.points)
+    {
+        point->Evaluate(parameters, &residual, ptr);
+        double rho[3] = {residual * residual, 1, 0};
+        if (scan.loss)
+        {
+            scan.loss->Evaluate(residual * residual, rho);
+        }
+        cost += 0.5 * rho[0];
+        gradient += rho[1] * residual * Vector3d(jacobians[0], jacobians[1], jacobians[2]);
+    }
+    return cost;
+}
+
+double evaluate_batch(const Scan &scan, double const *const *parameters, Vector3d &gradient, VectorXd &residuals, MatrixXd &jacobians)
+{
+    double *ptr[3] = {jacobians.col(0).data(), jacobians.col(1).data(), jacobians.col(2).data()};
+    scan.batch->Evaluate(parameters, residuals.data(), ptr);
+    gradient = jacobians.transpose() * residuals;
+    return 0.5 * residuals.squaredNorm();
+}
+
+int main(int argc, char **argv)
+{
+    SE3d Twc1(Quaterniond(AngleAxisd(0.3, Vector3d::UnitZ())), Vector3d(10, 5, 0.5));
+    // relative pose of the current scan, estimated with small errors
+    double rpyxyz_true[6] = {0.05, 0.01, -0.02, 1.0, 0.1, 0.02};
+    double rpyxyz[6] = {0.06, 0.005, -0.01, 1.1, 0.05, 0.0};
+    SE3d Twc2 = Twc1 * rpyxyz2se3(rpyxyz_true);
+
+    Scan scans[2];
+    scans[0].name = "ground";
+    scans[0].indices[0] = 1, scans[0].indices[1] = 2, scans[0].indices[2] = 5;
+    scans[0].huber = 0;
+    scans[1].name = "segmented";
+    scans[1].indices[0] = 0, scans[1].indices[1] = 3, scans[1].indices[2] = 4;
+    scans[1].huber = 0.1;
+
+    bool ok = true;
+    int n = 50;
+    for (int k = 0; k < 2; k++)
+    {
+        Scan &scan = scans[k];
+        create_scan(scan, Twc1, rpyxyz, Twc2, k);
+        double *parameters[3] = {rpyxyz + scan.indices[0], rpyxyz + scan.indices[1], rpyxyz + scan.indices[2]};
+
+        Vector3d gradient_points, gradient_batch;
+        VectorXd residuals(num_points);
+        MatrixXd jacobians(num_points, 3);
+        double cost_points = evaluate_points(scan, parameters, gradient_points);
+        double cost_batch = evaluate_batch(scan, parameters, gradient_batch, residuals, jacobians);
+        double error_cost = std::abs(cost_batch - cost_points) / cost_points;
+        double error_gradient = (gradient_batch - gradient_points).norm() / gradient_points.norm();
+        std::cout << scan.name << ": error of cost " << error_cost << ", of gradient " << error_gradient << std::endl;
+        ok &= bench::check(error_cost < 1e-9, scan.name + " cost is the same as per-point blocks");
+        ok &= bench::check(error_gradient < 1e-9, scan.name + " gradient is the same as per-point blocks");
+        if (scan.huber == 0)
+        {
+            // without loss, residuals and jacobians are the same one by one
+            double error_residual = 0, error_jacobian = 0, residual, jacobian[3];
+            double *ptr[3] = {jacobian, jacobian + 1, jacobian + 2};
+            for (int i = 0; i < num_points; i++)
+            {
+                scan.points[i]->Evaluate(parameters, &residual, ptr);
+                error_residual = std::max(error_residual, std::abs(residual - residuals(i)));
+                error_jacobian = std::max(error_jacobian, (Vector3d(jacobian[0], jacobian[1], jacobian[2]) - jacobians.row(i).transpose()).norm());
+            }
+            std::cout << scan.name << ": error of residuals " << error_residual << " m, of jacobians " << error_jacobian << std::endl;
+            ok &= bench::check(error_residual < 1e-9 && error_jacobian < 1e-9, scan.name + " residuals and jacobians are the same as per-point blocks");
+        }
+        else
+        {
+            int num_outliers = (residuals.array().abs() > scan.huber).count();
+            std::cout << scan.name << ": " << num_outliers << " of " << num_points << " residuals are scaled by the huber loss" << std::endl;
+            ok &= bench::check(num_outliers > 0 && num_outliers < num_points, scan.name + " has residuals in both parts of the huber loss");
+        }
+
+        double t_points = bench::time_us(n, [&]() { evaluate_points(scan, parameters, gradient_points); });
+        double t_batch = bench::time_us(n, [&]() { evaluate_batch(scan, parameters, gradient_batch, residuals, jacobians); });
+        bench::report(scan.name + " scan of " + std::to_string(num_points) + " points", t_points, t_batch);
+        ok &= bench::check(t_batch < t_points, scan.name + " batched block is faster");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+// features from the slab pool against std::make_shared (malloc), in the patterns of the threads,
+// and handles of landmarks against weak pointers.
+#include "bench.h"
+#include "lvio_fusion/visual/feature.h"
+#include "lvio_fusion/visual/landmark.h"
+
+#include <deque>
+
+using namespace lvio_fusion;
+
+typedef std::vector<visual::Feature::Ptr> Features;
+
+const int num_frames = 2000;
+const int num_features = 500; // per frame
+const int num_kept = 20;      // frames alive at the same time
+
+Features create(bool pool, int frame)
+{
+    Features features(num_features);
+    for (int i = 0; i < num_features; i++)
+    {
+        features[i] = pool ? std::allocate_shared<visual::Feature>(PoolAllocator<visual::Feature>())
+                           : std::make_shared<visual::Feature>();
+        features[i]->descriptor = frame * num_features + i;
+    }
+    return features;
+}
+
+// no object is overwritten by another one
+bool check(const Features &features, int frame)
+{
+    for (int i = 0; i < num_features; i++)
+    {
+        if (features[i]->descriptor != frame * num_features + i)
+            return false;
+    }
+    return true;
+}
+
+// the frontend creates features and frees them when its frames leave
+bool one_thread(bool pool)
+{
+    std::deque<Features> frames;
+    bool ok = true;
+    for (int frame = 0; frame < num_frames; frame++)
+    {
+        frames.push_back(create(pool, frame));
+        if (frames.size() > num_kept)
+        {
+            ok &= check(frames.front(), frame - num_kept);
+            frames.pop_front();
+        }
+    }
+    return ok;
+}
+
+// the frontend creates features, and the backend frees them
+bool two_threads(bool pool)
+{
+    std::deque<std::pair<int, Features>> queue;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool ok = true;
+    std::thread consumer([&] {
+        for (int n = 0; n < num_frames;)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return !queue.empty(); });
+            auto pair = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            ok &= check(pair.second, pair.first);
+            pair.second.clear();
+            n++;
+        }
+    });
+    for (int frame = 0; frame < num_frames; frame++)
+    {
+        Features features = create(pool, frame);
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.emplace_back(frame, std::move(features));
+        cond.notify_one();
+    }
+    consumer.join();
+    return ok;
+}
+
+// frontend, backend, loop and lidar threads at the same time
+bool four_threads(bool pool)
+{
+    std::vector<std::thread> threads;
+    bool ok[4];
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&ok, i, pool] { ok[i] = one_thread(pool); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return ok[0] && ok[1] && ok[2] && ok[3];
+}
+
+// links of features to landmarks, as the backend walks them
+bool links()
+{
+    std::vector<visual::Landmark::Ptr> landmarks;
+    std::vector<std::weak_ptr<visual::Landmark>> weak;
+    std::vector<Handle<visual::Landmark>> handles;
+    for (int i = 0; i < num_kept * num_features; i++)
+    {
+        landmarks.push_back(visual::Landmark::Create(1));
+        weak.push_back(landmarks.back());
+        handles.push_back(landmarks.back());
+    }
+    unsigned long sum_weak = 0, sum_handles = 0;
+    double time_weak = bench::time_us(20, [&] {
+        for (auto &landmark : weak)
+        {
+            sum_weak += landmark.lock()->id;
+        }
+    });
+    double time_handles = bench::time_us(20, [&] {
+        for (auto &landmark : handles)
+        {
+            sum_handles += landmark.get()->id;
+        }
+    });
+    bench::report("links to " + std::to_string(landmarks.size()) + " landmarks, weak_ptr -> handles", time_weak, time_handles);
+    bool ok = bench::check(sum_weak == sum_handles, "handles refer to the same landmarks");
+
+    // a handle expires with its landmark, a new landmark in the same slot does not bring it back
+    Handle<visual::Landmark> handle = landmarks.back();
+    landmarks.pop_back();
+    auto landmark = visual::Landmark::Create(1);
+    ok &= bench::check(handle.expired() && !handle.lock() && Handle<visual::Landmark>(landmark).get() == landmark.get(), "handles expire with their landmarks");
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    std::vector<std::pair<std::string, std::function<bool(bool)>>> cases = {
+        {"1 thread", one_thread}, {"2 threads, freed by the other", two_threads}, {"4 threads", four_threads}};
+    for (auto &pair : cases)
+    {
+        bool ok_malloc = true, ok_pool = true;
+        double time_malloc = bench::time_us(5, [&] { ok_malloc &= pair.second(false); });
+        double time_pool = bench::time_us(5, [&] { ok_pool &= pair.second(true); });
+        bench::report(pair.first + ", " + std::to_string(num_frames * num_features) + " features", time_malloc, time_pool);
+        ok &= bench::check(ok_malloc && ok_pool, pair.first + ": no feature is overwritten");
+    }
+    ok &= links();
+    return ok ? 0 : 1;
+}
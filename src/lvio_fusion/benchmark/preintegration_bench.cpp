@@ -0,0 +1,169 @@
+// propagation of the jacobian and covariance of preintegration, blocked against the dense 15x15 products.
+#include "bench.h"
+#include "lvio_fusion/imu/preintegration.h"
+
+#include <random>
+
+using namespace lvio_fusion;
+
+const double acc_n = 0.08, acc_w = 0.00004, gyr_n = 0.004, gyr_w = 2.0e-6;
+const double imu_dt = 0.005;   // 200 Hz
+const int num_samples = 200;   // samples between two keyframes
+
+// the propagation with dense F (15x15) and V (15x18), which the blocked one replaces
+struct DenseIntegration
+{
+    Matrix<double, 15, 15> jacobian = Matrix<double, 15, 15>::Identity(), covariance = Matrix<double, 15, 15>::Zero();
+    Matrix<double, 18, 18> noise = Matrix<double, 18, 18>::Zero();
+
+    DenseIntegration()
+    {
+        noise.block<3, 3>(0, 0) = (acc_n * acc_n) * Matrix3d::Identity();
+        noise.block<3, 3>(3, 3) = (gyr_n * gyr_n) * Matrix3d::Identity();
+        noise.block<3, 3>(6, 6) = (acc_n * acc_n) * Matrix3d::Identity();
+        noise.block<3, 3>(9, 9) = (gyr_n * gyr_n) * Matrix3d::Identity();
+        noise.block<3, 3>(12, 12) = (acc_w * acc_w) * Matrix3d::Identity();
+        noise.block<3, 3>(15, 15) = (gyr_w * gyr_w) * Matrix3d::Identity();
+    }
+
+    void MidPointIntegration(
+        double _dt,
+        const Vector3d &_acc_0, const Vector3d &_gyr_0,
+        const Vector3d &_acc_1, const Vector3d &_gyr_1,
+        const Vector3d &delta_p, const Quaterniond &delta_q, const Vector3d &delta_v,
+        const Vector3d &linearized_ba, const Vector3d &linearized_bg,
+        Vector3d &result_delta_p, Quaterniond &result_delta_q, Vector3d &result_delta_v,
+        Vector3d &result_linearized_ba, Vector3d &result_linearized_bg, bool update_jacobian)
+    {
+        Vector3d un_acc_0 = delta_q * (_acc_0 - linearized_ba);
+        Vector3d un_gyr = 0.5 * (_gyr_0 + _gyr_1) - linearized_bg;
+        result_delta_q = delta_q * Quaterniond(1, un_gyr(0) * _dt / 2, un_gyr(1) * _dt / 2, un_gyr(2) * _dt / 2);
+        Vector3d un_acc_1 = result_delta_q * (_acc_1 - linearized_ba);
+        Vector3d un_acc = 0.5 * (un_acc_0 + un_acc_1);
+        result_delta_p = delta_p + delta_v * _dt + 0.5 * un_acc * _dt * _dt;
+        result_delta_v = delta_v + un_acc * _dt;
+        result_linearized_ba = linearized_ba;
+        result_linearized_bg = linearized_bg;
+
+        if (update_jacobian)
+        {
+            Vector3d w_x = 0.5 * (_gyr_0 + _gyr_1) - linearized_bg;
+            Vector3d a_0_x = _acc_0 - linearized_ba;
+            Vector3d a_1_x = _acc_1 - linearized_ba;
+            Matrix3d R_w_x, R_a_0_x, R_a_1_x;
+
+            R_w_x << 0, -w_x(2), w_x(1),
+                w_x(2), 0, -w_x(0),
+                -w_x(1), w_x(0), 0;
+            R_a_0_x << 0, -a_0_x(2), a_0_x(1),
+                a_0_x(2), 0, -a_0_x(0),
+                -a_0_x(1), a_0_x(0), 0;
+            R_a_1_x << 0, -a_1_x(2), a_1_x(1),
+                a_1_x(2), 0, -a_1_x(0),
+                -a_1_x(1), a_1_x(0), 0;
+
+            MatrixXd F = MatrixXd::Zero(15, 15);
+            F.block<3, 3>(0, 0) = Matrix3d::Identity();
+            F.block<3, 3>(0, 3) = -0.25 * delta_q.toRotationMatrix() * R_a_0_x * _dt * _dt +
+                                  -0.25 * result_delta_q.toRotationMatrix() * R_a_1_x * (Matrix3d::Identity() - R_w_x * _dt) * _dt * _dt;
+            F.block<3, 3>(0, 6) = MatrixXd::Identity(3, 3) * _dt;
+            F.block<3, 3>(0, 9) = -0.25 * (delta_q.toRotationMatrix() + result_delta_q.toRotationMatrix()) * _dt * _dt;
+            F.block<3, 3>(0, 12) = -0.25 * result_delta_q.toRotationMatrix() * R_a_1_x * _dt * _dt * -_dt;
+            F.block<3, 3>(3, 3) = Matrix3d::Identity() - R_w_x * _dt;
+            F.block<3, 3>(3, 12) = -1.0 * MatrixXd::Identity(3, 3) * _dt;
+            F.block<3, 3>(6, 3) = -0.5 * delta_q.toRotationMatrix() * R_a_0_x * _dt +
+                                  -0.5 * result_delta_q.toRotationMatrix() * R_a_1_x * (Matrix3d::Identity() - R_w_x * _dt) * _dt;
+            F.block<3, 3>(6, 6) = Matrix3d::Identity();
+            F.block<3, 3>(6, 9) = -0.5 * (delta_q.toRotationMatrix() + result_delta_q.toRotationMatrix()) * _dt;
+            F.block<3, 3>(6, 12) = -0.5 * result_delta_q.toRotationMatrix() * R_a_1_x * _dt * -_dt;
+            F.block<3, 3>(9, 9) = Matrix3d::Identity();
+            F.block<3, 3>(12, 12) = Matrix3d::Identity();
+
+            MatrixXd V = MatrixXd::Zero(15, 18);
+            V.block<3, 3>(0, 0) = 0.25 * delta_q.toRotationMatrix() * _dt * _dt;
+            V.block<3, 3>(0, 3) = 0.25 * -result_delta_q.toRotationMatrix() * R_a_1_x * _dt * _dt * 0.5 * _dt;
+            V.block<3, 3>(0, 6) = 0.25 * result_delta_q.toRotationMatrix() * _dt * _dt;
+            V.block<3, 3>(0, 9) = V.block<3, 3>(0, 3);
+            V.block<3, 3>(3, 3) = 0.5 * MatrixXd::Identity(3, 3) * _dt;
+            V.block<3, 3>(3, 9) = 0.5 * MatrixXd::Identity(3, 3) * _dt;
+            V.block<3, 3>(6, 0) = 0.5 * delta_q.toRotationMatrix() * _dt;
+            V.block<3, 3>(6, 3) = 0.5 * -result_delta_q.toRotationMatrix() * R_a_1_x * _dt * 0.5 * _dt;
+            V.block<3, 3>(6, 6) = 0.5 * result_delta_q.toRotationMatrix() * _dt;
+            V.block<3, 3>(6, 9) = V.block<3, 3>(6, 3);
+            V.block<3, 3>(9, 12) = MatrixXd::Identity(3, 3) * _dt;
+            V.block<3, 3>(12, 15) = MatrixXd::Identity(3, 3) * _dt;
+
+            jacobian = F * jacobian;
+            covariance = F * covariance * F.transpose() + V * noise * V.transpose();
+        }
+    }
+};
+
+struct Samples
+{
+    std::vector<Vector3d> acc, gyr;
+};
+
+// a car accelerating and turning, with the noise of the imu
+Samples create_samples(int n)
+{
+    std::mt19937 gen(0);
+    std::normal_distribution<double> na(0, acc_n / std::sqrt(imu_dt)), ng(0, gyr_n / std::sqrt(imu_dt));
+    Samples samples;
+    for (int i = 0; i <= n; i++)
+    {
+        double t = i * imu_dt;
+        samples.acc.push_back(Vector3d(1.5 * std::sin(t), 0.8 * std::cos(2 * t), 9.81) + Vector3d(na(gen), na(gen), na(gen)));
+        samples.gyr.push_back(Vector3d(0.01, -0.02, 0.3 * std::sin(t)) + Vector3d(ng(gen), ng(gen), ng(gen)));
+    }
+    return samples;
+}
+
+// integrate the samples from identity, as Propagate does
+template <typename T>
+void integrate(T &integration, const Samples &samples)
+{
+    Vector3d delta_p = Vector3d::Zero(), delta_v = Vector3d::Zero();
+    Vector3d ba(0.01, 0.02, -0.01), bg(0.001, -0.002, 0.003);
+    Quaterniond delta_q = Quaterniond::Identity();
+    integration.jacobian.setIdentity();
+    integration.covariance.setZero();
+    for (int i = 0; i + 1 < (int)samples.acc.size(); i++)
+    {
+        Vector3d result_delta_p, result_delta_v, result_ba, result_bg;
+        Quaterniond result_delta_q;
+        integration.MidPointIntegration(imu_dt, samples.acc[i], samples.gyr[i], samples.acc[i + 1], samples.gyr[i + 1],
+                                        delta_p, delta_q, delta_v, ba, bg,
+                                        result_delta_p, result_delta_q, result_delta_v, result_ba, result_bg, true);
+        delta_p = result_delta_p;
+        delta_q = result_delta_q.normalized();
+        delta_v = result_delta_v;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Imu::Create(SE3d(), acc_n, acc_w, gyr_n, gyr_w, 9.81);
+    Samples samples = create_samples(num_samples);
+    DenseIntegration dense;
+    imu::Preintegration::Ptr blocked = imu::Preintegration::Create(Bias());
+
+    integrate(dense, samples);
+    integrate(*blocked, samples);
+    double error_jacobian = (blocked->jacobian - dense.jacobian).norm() / dense.jacobian.norm();
+    double error_covariance = (blocked->covariance - dense.covariance).norm() / dense.covariance.norm();
+    std::cout << "relative error of jacobian " << error_jacobian << ", of covariance " << error_covariance << std::endl;
+
+    bool ok = true;
+    ok &= bench::check(error_jacobian < 1e-12, "jacobian is the same as the dense product");
+    // the blocked noise term takes R * R^T = I, result_delta_q is not normalized yet, so they differ by O((w * dt)^2)
+    ok &= bench::check(error_covariance < 1e-8, "covariance is the same as the dense product");
+    ok &= bench::check(blocked->covariance.isApprox(blocked->covariance.transpose(), 1e-12), "covariance is symmetric");
+
+    int n = 50;
+    double t_dense = bench::time_us(n, [&]() { integrate(dense, samples); }) / num_samples;
+    double t_blocked = bench::time_us(n, [&]() { integrate(*blocked, samples); }) / num_samples;
+    bench::report("MidPointIntegration per sample", t_dense, t_blocked);
+    ok &= bench::check(t_blocked < t_dense, "blocked propagation is faster");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// batched midpoint triangulation against the SVD of each point, for stereo and for two frames of a moving camera.
+#include "bench.h"
+#include "lvio_fusion/utility.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace lvio_fusion;
+
+const int num_points = 1000;
+const double pixel_noise = 0.5 / 718; // half a pixel of KITTI in the normalized plane
+
+struct Scene
+{
+    std::vector<double> depths; // depths in view 0
+    ArrayXd x0, y0, x1, y1;
+};
+
+Scene create_scene(const SE3d &pose0, const SE3d &pose1, double noise, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<double> ux(-15, 15), uy(-3, 3), uz(3, 60);
+    std::normal_distribution<double> n(0, noise);
+    Scene scene;
+    scene.x0.resize(num_points);
+    scene.y0.resize(num_points);
+    scene.x1.resize(num_points);
+    scene.y1.resize(num_points);
+    for (int i = 0; i < num_points; i++)
+    {
+        Vector3d pw(ux(gen), uy(gen), uz(gen));
+        Vector3d pc0 = pose0 * pw, pc1 = pose1 * pw;
+        scene.depths.push_back(pc0.z());
+        scene.x0[i] = pc0.x() / pc0.z() + n(gen);
+        scene.y0[i] = pc0.y() / pc0.z() + n(gen);
+        scene.x1[i] = pc1.x() / pc1.z() + n(gen);
+        scene.y1[i] = pc1.y() / pc1.z() + n(gen);
+    }
+    return scene;
+}
+
+std::vector<double> triangulate_svd(const SE3d &pose0, const SE3d &pose1, const Scene &scene)
+{
+    std::vector<double> depths(num_points);
+    for (int i = 0; i < num_points; i++)
+    {
+        Vector3d pw;
+        triangulate(pose0, pose1, Vector3d(scene.x0[i], scene.y0[i], 1), Vector3d(scene.x1[i], scene.y1[i], 1), pw);
+        depths[i] = (pose0 * pw).z();
+    }
+    return depths;
+}
+
+// median relative error of depths, rays near the epipole make the mean meaningless
+template <typename T>
+double median_error(const T &depths, const std::vector<double> &truth)
+{
+    std::vector<double> errors(num_points);
+    for (int i = 0; i < num_points; i++)
+    {
+        errors[i] = std::fabs(depths[i] - truth[i]) / truth[i];
+    }
+    std::nth_element(errors.begin(), errors.begin() + num_points / 2, errors.end());
+    return errors[num_points / 2];
+}
+
+bool run(const std::string &name, const SE3d &pose0, const SE3d &pose1)
+{
+    std::mt19937 gen(1);
+    bool ok = true;
+
+    // exact without noise
+    Scene scene = create_scene(pose0, pose1, 0, gen);
+    ArrayXd depths;
+    triangulate(pose0, pose1, scene.x0, scene.y0, scene.x1, scene.y1, depths);
+    ok &= bench::check(median_error(depths, scene.depths) < 1e-9, name + ": exact without noise");
+
+    // as accurate as SVD with noise, and close to it point by point
+    scene = create_scene(pose0, pose1, pixel_noise, gen);
+    std::vector<double> depths_svd;
+    double time_svd = bench::time_us(10, [&] { depths_svd = triangulate_svd(pose0, pose1, scene); });
+    double time_batch = bench::time_us(10, [&] { triangulate(pose0, pose1, scene.x0, scene.y0, scene.x1, scene.y1, depths); });
+    bench::report(name + ", " + std::to_string(num_points) + " points", time_svd, time_batch);
+
+    double error_svd = median_error(depths_svd, scene.depths), error_batch = median_error(depths, scene.depths);
+    std::cout << name << ": median relative error of depths, svd " << error_svd << ", batch " << error_batch
+              << ", between them " << median_error(depths, depths_svd) << std::endl;
+    ok &= bench::check(error_batch < 1.05 * error_svd, name + ": as accurate as svd");
+    ok &= bench::check(median_error(depths, depths_svd) < 0.25 * error_svd, name + ": close to svd");
+    return ok;
+}
+
+int main()
+{
+    // pose of camera: world to camera
+    SE3d left, right(Matrix3d::Identity(), Vector3d(-0.54, 0, 0));
+    SE3d moved(AngleAxisd(0.05, Vector3d::UnitY()).toRotationMatrix(), Vector3d(0.1, 0.02, -1.2));
+    bool ok = run("stereo", left, right);
+    ok &= run("motion", left, moved);
+    return ok ? 0 : 1;
+}
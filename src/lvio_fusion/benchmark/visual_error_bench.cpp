@@ -0,0 +1,164 @@
+// analytic jacobians of the reprojection errors against automatic differentiation,
+// on landmarks observed by a stereo camera moving forward.
+// jacobians of poses are compared in the tangent space of the pose parameterization of the backend.
+#include "bench.h"
+#include "lvio_fusion/ceres/visual_error.hpp"
+
+#include <random>
+
+using namespace lvio_fusion;
+
+const int num_blocks = 1000;
+const double noise = 1; // pixels
+
+struct CostBlock
+{
+    std::unique_ptr<ceres::CostFunction> analytic, autodiff;
+    std::vector<double *> parameters;
+};
+
+// pixel of a point in the world, observed by the camera of the robot at pose
+Vector2d project(Camera::Ptr camera, const SE3d &pose, const Vector3d &pw)
+{
+    Vector3d pc = camera->extrinsic.inverse() * (pose.inverse() * pw);
+    return Vector2d(camera->fx * pc.x() / pc.z() + camera->cx, camera->fy * pc.y() / pc.z() + camera->cy);
+}
+
+// frames and inverse depths are kept by the caller, blocks point to them
+void create_blocks(std::vector<SE3d> &frames, std::vector<double> &inv_depths,
+                   std::vector<CostBlock> &pose_only, std::vector<CostBlock> &two_frame, std::vector<CostBlock> &two_camera)
+{
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::normal_distribution<double> n(0, noise);
+    frames.reserve(2 * num_blocks);
+    inv_depths.reserve(2 * num_blocks);
+    auto left = Camera::Get(0), right = Camera::Get(1);
+    for (int i = 0; i < num_blocks; i++)
+    {
+        // the robot moves about 1 m forward, x is forward
+        SE3d pose1(Quaterniond(AngleAxisd(2 * M_PI * u(gen), Vector3d::UnitZ())), Vector3d(100 * u(gen), 100 * u(gen), u(gen)));
+        SE3d motion(Quaterniond(AngleAxisd(0.05 * (u(gen) - 0.5), Vector3d(u(gen), u(gen), 1).normalized())), Vector3d(1, 0.1 * (u(gen) - 0.5), 0.02 * (u(gen) - 0.5)));
+        frames.push_back(pose1);
+        frames.push_back(pose1 * motion);
+        SE3d &frame1 = frames[2 * i], &frame2 = frames[2 * i + 1];
+
+        // first observed in the right image of the first frame
+        Vector2d right_ob(1241 * u(gen), 376 * u(gen));
+        double depth = 5 + 50 * u(gen);
+        Vector3d pb = right->extrinsic * Vector3d((right_ob.x() - right->cx) / right->fx * depth, (right_ob.y() - right->cy) / right->fy * depth, depth);
+        Vector3d pw = frame1 * pb;
+        Vector2d left_ob = project(left, frame1, pw) + Vector2d(n(gen), n(gen));
+        Vector2d ob = project(left, frame2, pw) + Vector2d(n(gen), n(gen));
+        // estimates of inverse depths are off by up to 10%
+        inv_depths.push_back(1 / depth * (1 + 0.2 * (u(gen) - 0.5)));
+        double *inv_d = &inv_depths.back();
+
+        CostBlock block;
+        block.analytic.reset(new PoseOnlyReprojectionCost(ob, pw, left, 1));
+        block.autodiff.reset(new ceres::AutoDiffCostFunction<PoseOnlyReprojectionError, 2, 7>(new PoseOnlyReprojectionError(ob, pw, left, 1)));
+        block.parameters = {frame2.data()};
+        pose_only.push_back(std::move(block));
+
+        block.analytic.reset(new TwoFrameReprojectionCost(right_ob, ob, left, right, 1));
+        block.autodiff.reset(new ceres::AutoDiffCostFunction<TwoFrameReprojectionError, 2, 1, 7, 7>(new TwoFrameReprojectionError(right_ob, ob, left, right, 1)));
+        block.parameters = {inv_d, frame1.data(), frame2.data()};
+        two_frame.push_back(std::move(block));
+
+        block.analytic.reset(new TwoCameraReprojectionCost(left_ob, right_ob, left, right, 5));
+        block.autodiff.reset(new ceres::AutoDiffCostFunction<TwoCameraReprojectionError, 2, 1>(new TwoCameraReprojectionError(left_ob, right_ob, left, right, 5)));
+        block.parameters = {inv_d};
+        two_camera.push_back(std::move(block));
+    }
+}
+
+// jacobian of a parameter block in its tangent space
+MatrixXd local_jacobian(const std::vector<double> &jacobian, double *parameter, int size)
+{
+    static ceres::ProductParameterization pose_parameterization(
+        new ceres::EigenQuaternionParameterization(),
+        new ceres::IdentityParameterization(3));
+    MatrixXd J = Eigen::Map<const Matrix<double, Dynamic, Dynamic, RowMajor>>(jacobian.data(), 2, size);
+    if (size != SE3d::num_parameters)
+        return J;
+    Matrix<double, 7, 6, RowMajor> plus_jacobian;
+    pose_parameterization.ComputeJacobian(parameter, plus_jacobian.data());
+    return J * plus_jacobian;
+}
+
+// max errors of residuals, in pixels, and of jacobians, relative to the norms of automatic ones
+void compare(const std::vector<CostBlock> &blocks, double &error_residual, double &error_jacobian)
+{
+    error_residual = error_jacobian = 0;
+    for (auto &block : blocks)
+    {
+        const std::vector<int> &sizes = block.autodiff->parameter_block_sizes();
+        std::vector<std::vector<double>> jacobians_analytic, jacobians_autodiff;
+        std::vector<double *> ptr_analytic, ptr_autodiff;
+        for (int size : sizes)
+        {
+            jacobians_analytic.emplace_back(2 * size);
+            jacobians_autodiff.emplace_back(2 * size);
+        }
+        for (int i = 0; i < sizes.size(); i++)
+        {
+            ptr_analytic.push_back(jacobians_analytic[i].data());
+            ptr_autodiff.push_back(jacobians_autodiff[i].data());
+        }
+        Vector2d residual_analytic, residual_autodiff;
+        block.analytic->Evaluate(block.parameters.data(), residual_analytic.data(), ptr_analytic.data());
+        block.autodiff->Evaluate(block.parameters.data(), residual_autodiff.data(), ptr_autodiff.data());
+        error_residual = std::max(error_residual, (residual_analytic - residual_autodiff).norm());
+        for (int i = 0; i < sizes.size(); i++)
+        {
+            MatrixXd J_analytic = local_jacobian(jacobians_analytic[i], block.parameters[i], sizes[i]);
+            MatrixXd J_autodiff = local_jacobian(jacobians_autodiff[i], block.parameters[i], sizes[i]);
+            error_jacobian = std::max(error_jacobian, (J_analytic - J_autodiff).norm() / J_autodiff.norm());
+        }
+    }
+}
+
+// evaluate residuals and jacobians of all blocks, as the solver does in an iteration
+void evaluate(const std::vector<CostBlock> &blocks, bool analytic)
+{
+    double residuals[2], jacobians[3][2 * 7];
+    double *ptr[3] = {jacobians[0], jacobians[1], jacobians[2]};
+    for (auto &block : blocks)
+    {
+        ceres::CostFunction *cost_function = analytic ? block.analytic.get() : block.autodiff.get();
+        cost_function->Evaluate(block.parameters.data(), residuals, ptr);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // x is forward in the robot frame, z is forward in the camera frame
+    Quaterniond q_bc(Matrix3d((Matrix3d() << 0, 0, 1, -1, 0, 0, 0, -1, 0).finished()));
+    Camera::Create(718.856, 718.856, 607.1928, 185.2157, SE3d(q_bc, Vector3d(0, 0, 1.65)));
+    Camera::Create(718.856, 718.856, 607.1928, 185.2157, SE3d(q_bc, Vector3d(0, -0.537, 1.65)));
+    std::vector<SE3d> frames;
+    std::vector<double> inv_depths;
+    std::vector<CostBlock> pose_only, two_frame, two_camera;
+    create_blocks(frames, inv_depths, pose_only, two_frame, two_camera);
+
+    bool ok = true;
+    int n = 20;
+    for (auto &pair : {std::make_pair("PoseOnlyReprojectionError", &pose_only),
+                       std::make_pair("TwoFrameReprojectionError", &two_frame),
+                       std::make_pair("TwoCameraReprojectionError", &two_camera)})
+    {
+        std::string name = pair.first;
+        const std::vector<CostBlock> &blocks = *pair.second;
+        double error_residual, error_jacobian;
+        compare(blocks, error_residual, error_jacobian);
+        std::cout << name << ": error of residuals " << error_residual << " px, of jacobians " << error_jacobian << std::endl;
+        ok &= bench::check(error_residual < 1e-9, name + " residuals are the same as automatic ones");
+        ok &= bench::check(error_jacobian < 1e-9, name + " jacobians are the same as automatic ones");
+
+        double t_autodiff = bench::time_us(n, [&]() { evaluate(blocks, false); }) / num_blocks;
+        double t_analytic = bench::time_us(n, [&]() { evaluate(blocks, true); }) / num_blocks;
+        bench::report(name + " per block", t_autodiff, t_analytic);
+        ok &= bench::check(t_analytic < t_autodiff, name + " analytic jacobians are faster");
+    }
+    return ok ? 0 : 1;
+}
@@ -30,7 +30,7 @@ public:
             estimator_ = estimator;
 
             // initialize map with ground turth
-            for (auto &pair : Map::Instance().keyframes)
+            for (auto &pair : Map::Instance().GetKeyFrames(0))
             {
                 pair.second->pose = GetGroundTruth(pair.first);
                 if (estimator->mapping)
@@ -40,8 +40,9 @@ public:
             }
 
             // initialize random distribution
-            double start_time = (++Map::Instance().keyframes.begin())->first;
-            double end_time = (--Map::Instance().keyframes.end())->first;
+            auto keyframes = Map::Instance().Snapshot();
+            double start_time = (++keyframes.begin())->first;
+            double end_time = (--keyframes.end())->first;
             u_ = std::uniform_real_distribution<double>(start_time, end_time);
             initialized_ = true;
         }
@@ -34,8 +34,12 @@ namespace adapt
 class Problem : public ceres::Problem
 {
 public:
+    Problem() = default;
+
+    explicit Problem(const ceres::Problem::Options &options) : ceres::Problem(options) {}
+
     template <typename... Ts>
-    void AddResidualBlock(
+    ceres::ResidualBlockId AddResidualBlock(
         ProblemType type,
         ceres::CostFunction *cost_function,
         ceres::LossFunction *loss_function,
@@ -44,6 +48,39 @@ public:
         ceres::ResidualBlockId id = ceres::Problem::AddResidualBlock(cost_function, loss_function, x0, xs...);
         types[id] = type;
         num_types[type]++;
+        return id;
+    }
+
+    ceres::ResidualBlockId AddResidualBlock(
+        ProblemType type,
+        ceres::CostFunction *cost_function,
+        ceres::LossFunction *loss_function,
+        const std::vector<double *> &parameter_blocks)
+    {
+        ceres::ResidualBlockId id = ceres::Problem::AddResidualBlock(cost_function, loss_function, parameter_blocks);
+        types[id] = type;
+        num_types[type]++;
+        return id;
+    }
+
+    void RemoveResidualBlock(ceres::ResidualBlockId id)
+    {
+        auto iter = types.find(id);
+        if (iter != types.end())
+        {
+            num_types[iter->second]--;
+            types.erase(iter);
+        }
+        ceres::Problem::RemoveResidualBlock(id);
+    }
+
+    void RemoveParameterBlock(double *values)
+    {
+        if (ParameterBlockSize(values) == SE3d::num_parameters)
+        {
+            num_frames--;
+        }
+        ceres::Problem::RemoveParameterBlock(values);
     }
 
     void AddParameterBlock(double *values, int size)
@@ -55,7 +92,7 @@ public:
                            int size,
                            ceres::LocalParameterization *local_parameterization)
     {
-        if (size == SE3d::num_parameters)
+        if (size == SE3d::num_parameters && !HasParameterBlock(values))
         {
             num_frames++;
         }
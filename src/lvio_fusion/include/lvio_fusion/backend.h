@@ -4,20 +4,22 @@
 #include "lvio_fusion/adapt/problem.h"
 #include "lvio_fusion/common.h"
 #include "lvio_fusion/frame.h"
+#include "lvio_fusion/frontend.h"
 #include "lvio_fusion/imu/initializer.h"
 #include "lvio_fusion/lidar/mapping.h"
 
 namespace lvio_fusion
 {
 
-class Frontend;
+class MarginalizationError;
+class BackendBench;
 
 class Backend
 {
 public:
     typedef std::shared_ptr<Backend> Ptr;
 
-    Backend(double window_size, bool update_weights);
+    Backend(double window_size, bool update_weights, bool marginalization);
 
     void SetFrontend(std::shared_ptr<Frontend> frontend) { frontend_ = frontend; }
 
@@ -27,30 +29,89 @@ public:
 
     void UpdateMap();
 
+    /**
+     * take the last state if it is newer, called by the frontend at every frame
+     * @param state         swapped with the last state
+     * @param init_time     imu initialization of the frontend starts from
+     * @return true if state is newer
+     */
+    bool TakeState(BackendState &state, double init_time);
+
+    // the frontend has applied the state
+    void StateApplied(unsigned long version);
+
     std::mutex mutex;
     double finished = 0;
 
 private:
+    friend class BackendBench; // benchmark/backend_bench builds problems with AddKeyframe
+
     void BackendLoop();
 
     void GlobalLoop();
 
     void Optimize();
 
-    void UpdateFrontend(SE3d transform, double time);
-
-    void BuildProblem(Frames &active_kfs, adapt::Problem &problem);
+    void PublishState(const FramesView &active_kfs, SE3d transform, double time);
+
+    // residual blocks added for a keyframe, and what they were built from
+    struct KeyframeResiduals
+    {
+        Frame::Ptr frame, last_frame;
+        bool imu = false;
+        bool weak = false; // weak constraints use the poses when they are built, so rebuild every time
+        double weight = 0;
+        std::vector<std::pair<unsigned long, double>> observations; // landmark id and time of its first frame
+        std::vector<Vector3d> points;                               // fixed landmarks in pose only blocks
+        std::vector<bool> far;                                      // weak or visual error of each observation
+        std::vector<ceres::ResidualBlockId> blocks;
+        std::vector<double *> inv_depths; // one for each block with an inverse depth
+        double global_end = 0;
+    };
+
+    void UpdateProblem(const FramesView &active_kfs);
+
+    void AddKeyframe(Frame::Ptr frame, Frame::Ptr last_frame, double start_time, adapt::Problem &problem, KeyframeResiduals &residuals,
+                     const std::unordered_set<unsigned long> *marginalized = nullptr);
+
+    void RemoveKeyframe(KeyframeResiduals &residuals);
+
+    void Marginalize(const FramesView &active_kfs);
+
+    // the sliding window problem persists between optimizations,
+    // only residual blocks of new or changed keyframes are built.
+    std::unique_ptr<ceres::LossFunction> loss_function_;
+    std::unique_ptr<ceres::LocalParameterization> local_parameterization_;
+    adapt::Problem problem_;
+    std::map<double, KeyframeResiduals> residuals_;
+    std::unordered_map<double *, int> inv_depths_; // number of residual blocks using each inverse depth
+
+    // keyframes leaving the window are marginalized into a prior, if enabled.
+    // observations in the prior are not added again as pose only blocks.
+    MarginalizationError *prior_ = nullptr;
+    ceres::ResidualBlockId prior_id_ = nullptr;
+    std::map<double, std::unordered_set<unsigned long>> marginalized_; // landmark ids of each keyframe
 
     std::weak_ptr<Frontend> frontend_;
     Mapping::Ptr mapping_;
     Initializer::Ptr initializer_;
 
+    // the backend fills back_state_ and swaps it with front_state_, which the frontend takes.
+    // the frontend mutex is never held by the backend, but the next optimization waits
+    // until the frontend has applied the last state, so they never touch the same frames.
+    BackendState front_state_, back_state_;
+    unsigned long version_ = 0, applied_version_ = 0;
+    double init_time_ = 0;
+    std::mutex mutex_state_;
+    std::condition_variable state_applied_;
+
     std::thread thread_, thread_global_;
     std::mutex mutex_optimize_;
     std::condition_variable map_update_;
     double global_end_ = 0;
     const double window_size_;
     const bool update_weights_;
+    const bool marginalization_;
 };
 
 } // namespace lvio_fusion
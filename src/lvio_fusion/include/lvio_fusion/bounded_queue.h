@@ -0,0 +1,59 @@
+#ifndef lvio_fusion_BOUNDED_QUEUE_H
+#define lvio_fusion_BOUNDED_QUEUE_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+// blocking queue with a fixed capacity, the producer waits while it is full.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    // return false if the queue is closed
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return queue_.size() < capacity_ || closed_; });
+        if (closed_)
+            return false;
+        queue_.push(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // return false if the queue is closed and empty
+    bool Pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !queue_.empty() || closed_; });
+        if (queue_.empty())
+            return false;
+        item = std::move(queue_.front());
+        queue_.pop();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    bool closed_ = false;
+    std::queue<T> queue_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_BOUNDED_QUEUE_H
@@ -29,7 +29,7 @@ public:
         Vector3d Bgj(parameters[7][0], parameters[7][1], parameters[7][2]);
         Eigen::Map<Matrix<double, 15, 1>> residual(residuals);
         residual = preintegration_->Evaluate(Pi, Qi, Vi, Bai, Bgi, Pj, Qj, Vj, Baj, Bgj);
-        Matrix<double, 15, 15> sqrt_info = LLT<Matrix<double, 15, 15>>(preintegration_->covariance.inverse()).matrixL().transpose();
+        Matrix<double, 15, 15> sqrt_info = preintegration_->GetSqrtInformation();
         residual = sqrt_info * residual;
         if (jacobians)
         {
@@ -144,10 +144,7 @@ public:
 
         Eigen::Map<Matrix<double, 15, 1>> residual(residuals);
         residual = preintegration_->Evaluate(Pi, Qi, Vi, Bai, Bgi, Pj, Qj, Vj, Baj, Bgj);
-        Matrix<double, 15, 15> cov_inv = preintegration_->covariance.inverse();
-        cov_inv.block<3, 3>(9, 9) = prior_a_ * Matrix3d::Identity();
-        cov_inv.block<3, 3>(12, 12) = prior_g_ * Matrix3d::Identity();
-        Matrix<double, 15, 15> sqrt_info = LLT<Matrix<double, 15, 15>>(cov_inv).matrixL().transpose();
+        Matrix<double, 15, 15> sqrt_info = preintegration_->GetSqrtInformation(prior_a_, prior_g_);
         residual = sqrt_info * residual;
         // LOG(INFO) << residual;
 
@@ -252,10 +249,7 @@ public:
 
         Eigen::Map<Matrix<double, 15, 1>> residual(residuals);
         residual = preintegration_->Evaluate(Pi, Qi, Vi, Bai, Bgi, Pj, Qj, Vj, Baj, Bgj, Rg);
-        Matrix<double, 15, 15> cov_inv = preintegration_->covariance.inverse();
-        cov_inv.block<3, 3>(9, 9) = prior_a_ * Matrix3d::Identity();
-        cov_inv.block<3, 3>(12, 12) = prior_g_ * Matrix3d::Identity();
-        Matrix<double, 15, 15> sqrt_info = LLT<Matrix<double, 15, 15>>(cov_inv).matrixL().transpose();
+        Matrix<double, 15, 15> sqrt_info = preintegration_->GetSqrtInformation(prior_a_, prior_g_);
         residual = sqrt_info * residual;
 
         return true;
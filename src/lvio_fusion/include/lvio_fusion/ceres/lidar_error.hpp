@@ -7,106 +7,122 @@
 namespace lvio_fusion
 {
 
-class LidarPlaneError
+// point-to-plane errors of all points of a scan in one residual block.
+// 3 of the relative pose rpyxyz are parameters, the others are constant.
+// the huber loss is applied to each residual, since a loss function of ceres applies to the whole block.
+class LidarPlaneBatchError : public ceres::CostFunction
 {
 public:
-    LidarPlaneError(Vector3d p, Vector3d pa, Vector3d pb, Vector3d pc)
-        : p_(p), pa_(pa)
+    /**
+     * @param Twc1      pose of the map frame
+     * @param rpyxyz    relative pose, the constant elements are read when evaluated
+     * @param i0,i1,i2  indices of the parameters in rpyxyz
+     * @param huber     scale of the huber loss, 0 for no loss
+     */
+    LidarPlaneBatchError(SE3d Twc1, double *rpyxyz, int i0, int i1, int i2, double huber)
+        : Twc1_(Twc1), rpyxyz_(rpyxyz), indices_{i0, i1, i2}, huber_(huber)
     {
-        abc_norm_ = (pa_ - pb).cross(pa_ - pc);
-        abc_norm_.normalize();
+        mutable_parameter_block_sizes()->assign(3, 1);
     }
 
-    template <typename T>
-    bool operator()(const T *Twc2, T *residual) const
+    // point p of the current scan is on the plane abc of the map
+    void Add(const Vector3d &p, const Vector3d &pa, const Vector3d &pb, const Vector3d &pc, double weight)
     {
-        T cp[3] = {T(p_.x()), T(p_.y()), T(p_.z())};
-        T pa[3] = {T(pa_.x()), T(pa_.y()), T(pa_.z())};
-        T abc_norm[3] = {T(abc_norm_.x()), T(abc_norm_.y()), T(abc_norm_.z())};
-        T lp[3], lp_pa[3];
-        ceres::SE3TransformPoint(Twc2, cp, lp);
-        ceres::Minus(lp, pa, lp_pa);
-        residual[0] = ceres::DotProduct(lp_pa, abc_norm);
-        return true;
-    }
-
-    static ceres::CostFunction *Create(Vector3d p, Vector3d pa, Vector3d pb, Vector3d pc)
-    {
-        return (new ceres::AutoDiffCostFunction<LidarPlaneError, 1, 7>(new LidarPlaneError(p, pa, pb, pc)));
-    }
-
-private:
-    Vector3d p_, pa_, abc_norm_;
-};
-
-class LidarPlaneErrorRPZ: public ceres::Error
-{
-public:
-    LidarPlaneErrorRPZ(LidarPlaneError origin_error, SE3d Twc1, double *rpyxyz, double weight)
-        : origin_error_(origin_error), Twc1_(Twc1), rpyxyz_(rpyxyz), Error(weight) {}
-
-    template <typename T>
-    bool operator()(const T *pitch, const T *roll, const T *z, T *residual) const
-    {
-        T Twc1[7], Twc2[7], relative_i_j[7], rpyxyz[6];
-        ceres::Cast(rpyxyz_, 6, rpyxyz);
-        //NOTE: the real order of rpy is y p r
-        rpyxyz[1] = *pitch;
-        rpyxyz[2] = *roll;
-        rpyxyz[5] = *z;
-        ceres::RpyxyzToSE3(rpyxyz, relative_i_j);
-        ceres::Cast(Twc1_.data(), SE3d::num_parameters, Twc1);
-        ceres::SE3Product(Twc1, relative_i_j, Twc2);
-        origin_error_(Twc2, residual);
-        residual[0] = T(weight_) * residual[0];
-        return true;
+        Vector3d abc_norm = (pa - pb).cross(pa - pc).normalized();
+        // r = n * (T1 * T12 * p - pa) = m * (R12 * p + t12) + c
+        Vector3d m = weight * (Twc1_.so3().inverse() * abc_norm);
+        for (int i = 0; i < 3; i++)
+        {
+            p_[i].push_back(p[i]);
+            m_[i].push_back(m[i]);
+        }
+        c_.push_back(weight * abc_norm.dot(Twc1_.translation() - pa));
+        set_num_residuals(c_.size());
     }
 
-    static ceres::CostFunction *Create(Vector3d p, Vector3d pa, Vector3d pb, Vector3d pc, SE3d Twc1, double *rpyxyz, double weight)
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
     {
-        LidarPlaneError origin_error(p, pa, pb, pc);
-        return (new ceres::AutoDiffCostFunction<LidarPlaneErrorRPZ, 1, 1, 1, 1>(new LidarPlaneErrorRPZ(origin_error, Twc1, rpyxyz, weight)));
-    }
-
-private:
-    LidarPlaneError origin_error_;
-    SE3d Twc1_;
-    double *rpyxyz_;
-};
-
-class LidarPlaneErrorYXY: public ceres::Error
-{
-public:
-    LidarPlaneErrorYXY(LidarPlaneError origin_error, SE3d Twc1, double *rpyxyz, double weight)
-        : origin_error_(origin_error), Twc1_(Twc1), rpyxyz_(rpyxyz), Error(weight) {}
-
-    template <typename T>
-    bool operator()(const T *yaw, const T *x, const T *y, T *residual) const
-    {
-        T Twc1[7], Twc2[7], relative_i_j[7], rpyxyz[6];
-        ceres::Cast(rpyxyz_, 6, rpyxyz);
-        //NOTE: the real order of rpy is y p r
-        rpyxyz[0] = *yaw;
-        rpyxyz[3] = *x;
-        rpyxyz[4] = *y;
-        ceres::RpyxyzToSE3(rpyxyz, relative_i_j);
-        ceres::Cast(Twc1_.data(), SE3d::num_parameters, Twc1);
-        ceres::SE3Product(Twc1, relative_i_j, Twc2);
-        origin_error_(Twc2, residual);
-        residual[0] = T(weight_) * residual[0];
+        double rpyxyz[6];
+        std::copy(rpyxyz_, rpyxyz_ + 6, rpyxyz);
+        for (int i = 0; i < 3; i++)
+        {
+            rpyxyz[indices_[i]] = parameters[i][0];
+        }
+        // R = Rz(yaw) * Ry(pitch) * Rx(roll)
+        Matrix3d R[3], dR[3];
+        for (int i = 0; i < 3; i++)
+        {
+            double c = cos(rpyxyz[i]), s = sin(rpyxyz[i]);
+            int axis = 2 - i, a = (axis + 1) % 3, b = (axis + 2) % 3; // z, y, x
+            R[i].setZero();
+            R[i](axis, axis) = 1;
+            R[i](a, a) = R[i](b, b) = c;
+            R[i](a, b) = -s;
+            R[i](b, a) = s;
+            dR[i].setZero();
+            dR[i](a, a) = dR[i](b, b) = -s;
+            dR[i](a, b) = -c;
+            dR[i](b, a) = c;
+        }
+        Vector3d t(rpyxyz[3], rpyxyz[4], rpyxyz[5]);
+        Matrix3d R12 = R[0] * R[1] * R[2];
+
+        // points are stored as arrays of x, y, z to be vectorized
+        const int n = num_residuals();
+        Eigen::Map<const ArrayXd> px(p_[0].data(), n), py(p_[1].data(), n), pz(p_[2].data(), n);
+        Eigen::Map<const ArrayXd> mx(m_[0].data(), n), my(m_[1].data(), n), mz(m_[2].data(), n);
+        auto m_A_p = [&](const Matrix3d &A) -> ArrayXd {
+            return mx * (A(0, 0) * px + A(0, 1) * py + A(0, 2) * pz) +
+                   my * (A(1, 0) * px + A(1, 1) * py + A(1, 2) * pz) +
+                   mz * (A(2, 0) * px + A(2, 1) * py + A(2, 2) * pz);
+        };
+        Eigen::Map<ArrayXd> residual(residuals, n);
+        residual = m_A_p(R12) + mx * t.x() + my * t.y() + mz * t.z() + Eigen::Map<const ArrayXd>(c_.data(), n);
+        for (int i = 0; jacobians && i < 3; i++)
+        {
+            if (!jacobians[i])
+                continue;
+            Eigen::Map<ArrayXd> jacobian(jacobians[i], n);
+            int k = indices_[i];
+            if (k < 3)
+            {
+                jacobian = m_A_p((k == 0 ? dR[0] : R[0]) * (k == 1 ? dR[1] : R[1]) * (k == 2 ? dR[2] : R[2]));
+            }
+            else
+            {
+                jacobian = Eigen::Map<const ArrayXd>(m_[k - 3].data(), n);
+            }
+        }
+
+        if (huber_ > 0)
+        {
+            // residual = sqrt(rho(r^2)) keeps the cost of ceres::HuberLoss
+            for (int j = 0; j < n; j++)
+            {
+                double r = std::abs(residual(j));
+                if (r <= huber_)
+                    continue;
+                double robust = std::sqrt(2 * huber_ * r - huber_ * huber_);
+                double scale = huber_ / robust;
+                residual(j) = residual(j) > 0 ? robust : -robust;
+                for (int i = 0; jacobians && i < 3; i++)
+                {
+                    if (jacobians[i])
+                    {
+                        jacobians[i][j] *= scale;
+                    }
+                }
+            }
+        }
         return true;
     }
 
-    static ceres::CostFunction *Create(Vector3d p, Vector3d pa, Vector3d pb, Vector3d pc, SE3d Twc1, double *rpyxyz, double weight)
-    {
-        LidarPlaneError origin_error(p, pa, pb, pc);
-        return (new ceres::AutoDiffCostFunction<LidarPlaneErrorYXY, 1, 1, 1, 1>(new LidarPlaneErrorYXY(origin_error, Twc1, rpyxyz, weight)));
-    }
-
 private:
-    LidarPlaneError origin_error_;
     SE3d Twc1_;
     double *rpyxyz_;
+    int indices_[3];
+    double huber_;
+    std::vector<double> p_[3], m_[3], c_;
 };
 
 } // namespace lvio_fusion
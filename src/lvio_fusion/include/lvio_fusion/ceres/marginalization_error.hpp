@@ -0,0 +1,308 @@
+#ifndef lvio_fusion_MARGINALIZATION_ERROR_H
+#define lvio_fusion_MARGINALIZATION_ERROR_H
+
+#include "lvio_fusion/adapt/problem.h"
+#include "lvio_fusion/common.h"
+#include "lvio_fusion/utility.h"
+
+#include <Eigen/Eigenvalues>
+#include <unordered_set>
+
+namespace lvio_fusion
+{
+
+// poses are [qx, qy, qz, qw, tx, ty, tz] with the local parameterization of the backend,
+// the tangent space is [rotation, translation].
+inline int local_size(int size)
+{
+    return size == SE3d::num_parameters ? 6 : size;
+}
+
+// dx = x - x0 in the tangent space of x0
+inline void minus(const double *x, const double *x0, int size, double *dx)
+{
+    if (size == SE3d::num_parameters)
+    {
+        // EigenQuaternionParameterization: q = [sin|d| * d / |d|, cos|d|] * q0
+        Quaterniond dq = Quaterniond(x[3], x[0], x[1], x[2]) * Quaterniond(x0[3], x0[0], x0[1], x0[2]).inverse();
+        if (dq.w() < 0)
+        {
+            dq.coeffs() = -dq.coeffs();
+        }
+        double norm = dq.vec().norm();
+        Map<Vector3d> dr(dx), dt(dx + 3);
+        dr = norm < 1e-12 ? dq.vec().eval() : (std::atan2(norm, dq.w()) / norm * dq.vec()).eval();
+        dt = Vector3d(x[4], x[5], x[6]) - Vector3d(x0[4], x0[5], x0[6]);
+    }
+    else
+    {
+        Map<VectorXd> dv(dx, size);
+        dv = Map<const VectorXd>(x, size) - Map<const VectorXd>(x0, size);
+    }
+}
+
+// linear prior on the states left in the window, from residual blocks of the marginalized states.
+// the prior is 0.5 * |r + J * dx|^2, dx is the difference to the linearization point.
+class MarginalizationError : public ceres::CostFunction
+{
+public:
+    /**
+     * marginalize parameter blocks by schur complement, the problem is not modified
+     * @param problem       the problem
+     * @param marginalized  parameter blocks to marginalize, each residual block uses at most one of size 1 (inverse depth)
+     * @param last_prior    residual block of the last prior, merged into the new one
+     * @return prior on the other parameter blocks of these residual blocks, NULL if none
+     */
+    static MarginalizationError *Create(adapt::Problem &problem, const std::unordered_set<double *> &marginalized,
+                                        ceres::ResidualBlockId last_prior = NULL)
+    {
+        std::vector<ceres::ResidualBlockId> residual_blocks, blocks;
+        std::unordered_set<ceres::ResidualBlockId> visited;
+        if (last_prior)
+        {
+            visited.insert(last_prior);
+            residual_blocks.push_back(last_prior);
+        }
+        for (auto para : marginalized)
+        {
+            problem.GetResidualBlocksForParameterBlock(para, &blocks);
+            for (auto id : blocks)
+            {
+                if (visited.insert(id).second)
+                {
+                    residual_blocks.push_back(id);
+                }
+            }
+        }
+
+        // order: inverse depths, other marginalized states, states to keep
+        std::unordered_map<double *, int> index;
+        std::vector<double *> depths, states, kept;
+        for (auto para : marginalized)
+        {
+            (problem.ParameterBlockSize(para) == 1 ? depths : states).push_back(para);
+        }
+        std::vector<double *> parameter_blocks;
+        for (auto id : residual_blocks)
+        {
+            problem.GetParameterBlocksForResidualBlock(id, &parameter_blocks);
+            for (auto para : parameter_blocks)
+            {
+                if (!marginalized.count(para) && !index.count(para))
+                {
+                    index[para] = 0;
+                    kept.push_back(para);
+                }
+            }
+        }
+        if (residual_blocks.empty() || kept.empty())
+            return NULL;
+
+        int n = 0;
+        for (auto para : depths)
+        {
+            index[para] = n++;
+        }
+        int d = n;
+        for (auto para : states)
+        {
+            index[para] = n;
+            n += local_size(problem.ParameterBlockSize(para));
+        }
+        int m = n;
+        for (auto para : kept)
+        {
+            index[para] = n;
+            n += local_size(problem.ParameterBlockSize(para));
+        }
+
+        // linearize at current states
+        MatrixXd H = MatrixXd::Zero(n, n);
+        VectorXd g = VectorXd::Zero(n);
+        for (auto id : residual_blocks)
+        {
+            problem.GetParameterBlocksForResidualBlock(id, &parameter_blocks);
+            const ceres::CostFunction *cost_function = problem.GetCostFunctionForResidualBlock(id);
+            const ceres::LossFunction *loss_function = problem.GetLossFunctionForResidualBlock(id);
+            int num_residuals = cost_function->num_residuals();
+            int num_blocks = parameter_blocks.size();
+            VectorXd r(num_residuals);
+            std::vector<Matrix<double, Dynamic, Dynamic, RowMajor>> J(num_blocks);
+            std::vector<double *> jacobians(num_blocks);
+            for (int i = 0; i < num_blocks; i++)
+            {
+                J[i].resize(num_residuals, problem.ParameterBlockSize(parameter_blocks[i]));
+                jacobians[i] = J[i].data();
+            }
+            if (!cost_function->Evaluate(parameter_blocks.data(), r.data(), jacobians.data()))
+                continue;
+
+            // the second derivative of huber loss is zero, scaling is enough
+            double scale = 1;
+            if (loss_function)
+            {
+                double rho[3];
+                loss_function->Evaluate(r.squaredNorm(), rho);
+                scale = std::sqrt(rho[1]);
+            }
+            r *= scale;
+            std::vector<MatrixXd> J_local(num_blocks);
+            for (int i = 0; i < num_blocks; i++)
+            {
+                if (J[i].cols() == SE3d::num_parameters)
+                {
+                    J_local[i].resize(num_residuals, 6);
+                    J_local[i].leftCols<3>() = scale * J[i].leftCols<4>() * quaternion_plus_jacobian(parameter_blocks[i]);
+                    J_local[i].rightCols<3>() = scale * J[i].rightCols<3>();
+                }
+                else
+                {
+                    J_local[i] = scale * J[i];
+                }
+            }
+            for (int i = 0; i < num_blocks; i++)
+            {
+                int a = index[parameter_blocks[i]];
+                for (int j = i; j < num_blocks; j++)
+                {
+                    int b = index[parameter_blocks[j]];
+                    MatrixXd Hij = J_local[i].transpose() * J_local[j];
+                    H.block(a, b, Hij.rows(), Hij.cols()) += Hij;
+                    if (a != b)
+                    {
+                        H.block(b, a, Hij.cols(), Hij.rows()) += Hij.transpose();
+                    }
+                }
+                g.segment(a, J_local[i].cols()) += J_local[i].transpose() * r;
+            }
+        }
+
+        // inverse depths only correlate with states, eliminate them by their diagonal first
+        VectorXd D_inv = H.diagonal().head(d).unaryExpr([](double x) { return x > 1e-8 ? 1 / x : 0; });
+        MatrixXd H_yd = H.block(d, 0, n - d, d);
+        MatrixXd H_y = H.bottomRightCorner(n - d, n - d) - H_yd * D_inv.asDiagonal() * H_yd.transpose();
+        VectorXd g_y = g.tail(n - d) - H_yd * D_inv.asDiagonal() * g.head(d);
+
+        // then other marginalized states
+        int s = m - d, k = n - m;
+        MatrixXd H_mm = 0.5 * (H_y.topLeftCorner(s, s) + H_y.topLeftCorner(s, s).transpose());
+        SelfAdjointEigenSolver<MatrixXd> saes(H_mm);
+        VectorXd values_inv = saes.eigenvalues().unaryExpr([](double x) { return x > 1e-8 ? 1 / x : 0; });
+        MatrixXd H_mm_inv = saes.eigenvectors() * values_inv.asDiagonal() * saes.eigenvectors().transpose();
+        MatrixXd H_rm = H_y.block(s, 0, k, s);
+        MatrixXd H_prior = H_y.bottomRightCorner(k, k) - H_rm * H_mm_inv * H_rm.transpose();
+        VectorXd g_prior = g_y.tail(k) - H_rm * H_mm_inv * g_y.head(s);
+
+        // H = J^T * J, g = J^T * r
+        SelfAdjointEigenSolver<MatrixXd> saes_prior(0.5 * (H_prior + H_prior.transpose()));
+        VectorXd values = saes_prior.eigenvalues().unaryExpr([](double x) { return x > 1e-8 ? x : 0; });
+        VectorXd values_sqrt = values.cwiseSqrt();
+        VectorXd values_inv_sqrt = values_sqrt.unaryExpr([](double x) { return x > 0 ? 1 / x : 0; });
+
+        MarginalizationError *error = new MarginalizationError;
+        error->J_ = values_sqrt.asDiagonal() * saes_prior.eigenvectors().transpose();
+        error->r_ = values_inv_sqrt.asDiagonal() * saes_prior.eigenvectors().transpose() * g_prior;
+        error->set_num_residuals(k);
+        for (auto para : kept)
+        {
+            int size = problem.ParameterBlockSize(para);
+            Block block;
+            block.values = para;
+            block.size = size;
+            block.index = index[para] - m;
+            block.x0 = Map<const VectorXd>(para, size);
+            block.snapshot = block.x0;
+            error->blocks_.push_back(block);
+            error->mutable_parameter_block_sizes()->push_back(size);
+        }
+        return error;
+    }
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        VectorXd dx(J_.cols());
+        for (int i = 0; i < blocks_.size(); i++)
+        {
+            minus(parameters[i], blocks_[i].x0.data(), blocks_[i].size, dx.data() + blocks_[i].index);
+        }
+        Map<VectorXd> residual(residuals, num_residuals());
+        residual = r_ + J_ * dx;
+
+        if (jacobians)
+        {
+            for (int i = 0; i < blocks_.size(); i++)
+            {
+                if (jacobians[i])
+                {
+                    // d(dx) is taken as the delta of the local parameterization
+                    Map<Matrix<double, Dynamic, Dynamic, RowMajor>> jacobian(jacobians[i], num_residuals(), blocks_[i].size);
+                    if (blocks_[i].size == SE3d::num_parameters)
+                    {
+                        jacobian.leftCols<4>() = J_.middleCols<3>(blocks_[i].index) * quaternion_plus_jacobian(parameters[i]).transpose();
+                        jacobian.rightCols<3>() = J_.middleCols<3>(blocks_[i].index + 3);
+                    }
+                    else
+                    {
+                        jacobian = J_.middleCols(blocks_[i].index, blocks_[i].size);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<double *> ParameterBlocks() const
+    {
+        std::vector<double *> parameter_blocks;
+        for (auto &block : blocks_)
+        {
+            parameter_blocks.push_back(block.values);
+        }
+        return parameter_blocks;
+    }
+
+    // record the states after the solver
+    void Snapshot()
+    {
+        for (auto &block : blocks_)
+        {
+            block.snapshot = Map<const VectorXd>(block.values, block.size);
+        }
+    }
+
+    // states corrected out of the solver (pose graph, lidar mapping, ...) move the linearization points along
+    void Follow()
+    {
+        for (auto &block : blocks_)
+        {
+            if (block.size == SE3d::num_parameters)
+            {
+                Eigen::Map<SE3d> x(block.values), x0(block.x0.data()), snapshot(block.snapshot.data());
+                x0 = x * snapshot.inverse() * x0;
+            }
+            else
+            {
+                block.x0 += Map<const VectorXd>(block.values, block.size) - block.snapshot;
+            }
+            block.snapshot = Map<const VectorXd>(block.values, block.size);
+        }
+    }
+
+private:
+    MarginalizationError() = default;
+
+    struct Block
+    {
+        double *values;
+        int size, index; // index in the tangent space of all kept states
+        VectorXd x0, snapshot;
+    };
+
+    std::vector<Block> blocks_;
+    MatrixXd J_;
+    VectorXd r_;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_MARGINALIZATION_ERROR_H
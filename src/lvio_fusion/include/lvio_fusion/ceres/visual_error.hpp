@@ -2,11 +2,15 @@
 #define lvio_fusion_VISUAL_ERROR_H
 
 #include "lvio_fusion/ceres/base.hpp"
+#include "lvio_fusion/utility.h"
 #include "lvio_fusion/visual/camera.h"
 
 namespace lvio_fusion
 {
 
+// create reprojection errors with analytic jacobians instead of automatic differentiation
+extern bool use_analytic_jacobian;
+
 template <typename T>
 inline void Reprojection(const T *pw, const T *Twc, Camera::Ptr camera, T *result)
 {
@@ -45,6 +49,167 @@ inline void Robot2Pixel(const T *pb, Camera::Ptr camera, T *result)
     result[1] = camera->fy * yp + camera->cy;
 }
 
+// intrinsics and inverse extrinsic of a camera, cached for analytic jacobians
+struct PinholeProjection
+{
+    PinholeProjection(Camera::Ptr camera)
+        : Rcb(camera->extrinsic.inverse().rotationMatrix()), tcb(camera->extrinsic.inverse().translation()),
+          Rbc(camera->extrinsic.rotationMatrix()), tbc(camera->extrinsic.translation()),
+          fx(camera->fx), fy(camera->fy), cx(camera->cx), cy(camera->cy) {}
+
+    // pixel of the point in the robot frame, and the jacobian w.r.t. the point
+    Vector2d Robot2Pixel(const Vector3d &pb, Matrix<double, 2, 3> &J) const
+    {
+        Vector3d pc = Rcb * pb + tcb;
+        double z_inv = 1 / pc.z();
+        Matrix<double, 2, 3> J_pc;
+        J_pc << fx * z_inv, 0, -fx * pc.x() * z_inv * z_inv,
+            0, fy * z_inv, -fy * pc.y() * z_inv * z_inv;
+        J = J_pc * Rcb;
+        return Vector2d(fx * pc.x() * z_inv + cx, fy * pc.y() * z_inv + cy);
+    }
+
+    // point in the robot frame, and the jacobian w.r.t. the inverse depth
+    Vector3d Pixel2Robot(const Vector2d &ob, double inv_d, Vector3d &J) const
+    {
+        Vector3d ps((ob.x() - cx) / fx, (ob.y() - cy) / fy, 1);
+        J = -Rbc * ps / (inv_d * inv_d);
+        return Rbc * ps / inv_d + tbc;
+    }
+
+    Matrix3d Rcb;
+    Vector3d tcb;
+    Matrix3d Rbc;
+    Vector3d tbc;
+    double fx, fy, cx, cy;
+};
+
+/**
+ * transform a point from the world frame to the robot frame
+ * @param Twb       pose [qx, qy, qz, qw, tx, ty, tz]
+ * @param J         jacobian w.r.t. the pose, can be used with ProductParameterization
+ */
+inline Vector3d world_to_robot(const double *Twb, const Vector3d &pw, Matrix<double, 3, 7> &J)
+{
+    Matrix3d Rbw = Quaterniond(Twb[3], Twb[0], Twb[1], Twb[2]).normalized().toRotationMatrix().transpose();
+    Vector3d d = pw - Vector3d(Twb[4], Twb[5], Twb[6]);
+    J.leftCols<4>() = 2 * Rbw * skew_symmetric(d) * quaternion_plus_jacobian(Twb).transpose();
+    J.rightCols<3>() = -Rbw;
+    return Rbw * d;
+}
+
+// transform a point from the robot frame to the world frame
+inline Vector3d robot_to_world(const double *Twb, const Vector3d &pb, Matrix<double, 3, 7> &J, Matrix3d &J_pb)
+{
+    Matrix3d Rwb = Quaterniond(Twb[3], Twb[0], Twb[1], Twb[2]).normalized().toRotationMatrix();
+    Vector3d d = Rwb * pb;
+    J.leftCols<4>() = -2 * skew_symmetric(d) * quaternion_plus_jacobian(Twb).transpose();
+    J.rightCols<3>() = Matrix3d::Identity();
+    J_pb = Rwb;
+    return d + Vector3d(Twb[4], Twb[5], Twb[6]);
+}
+
+class PoseOnlyReprojectionCost : public ceres::SizedCostFunction<2, 7>
+{
+public:
+    PoseOnlyReprojectionCost(Vector2d ob, Vector3d pw, Camera::Ptr camera, double weight)
+        : ob_(ob), pw_(pw), camera_(camera), weight_(weight) {}
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        Matrix<double, 3, 7> J_pose;
+        Matrix<double, 2, 3> J_pb;
+        Vector3d pb = world_to_robot(parameters[0], pw_, J_pose);
+        Eigen::Map<Vector2d> residual(residuals);
+        residual = weight_ * (camera_.Robot2Pixel(pb, J_pb) - ob_);
+        if (jacobians && jacobians[0])
+        {
+            Eigen::Map<Matrix<double, 2, 7, RowMajor>> jacobian_pose(jacobians[0]);
+            jacobian_pose = weight_ * J_pb * J_pose;
+        }
+        return true;
+    }
+
+private:
+    Vector2d ob_;
+    Vector3d pw_;
+    PinholeProjection camera_;
+    double weight_;
+};
+
+class TwoFrameReprojectionCost : public ceres::SizedCostFunction<2, 1, 7, 7>
+{
+public:
+    TwoFrameReprojectionCost(Vector2d first_ob, Vector2d ob, Camera::Ptr left, Camera::Ptr right, double weight)
+        : first_ob_(first_ob), ob_(ob), left_(left), right_(right), weight_(weight) {}
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        Vector3d J_inv_d;
+        Matrix3d J_pb;
+        Matrix<double, 3, 7> J_pose1, J_pose2;
+        Matrix<double, 2, 3> J_pb2;
+        Vector3d pb = right_.Pixel2Robot(first_ob_, parameters[0][0], J_inv_d);
+        Vector3d pw = robot_to_world(parameters[1], pb, J_pose1, J_pb);
+        Vector3d pb2 = world_to_robot(parameters[2], pw, J_pose2);
+        Eigen::Map<Vector2d> residual(residuals);
+        residual = weight_ * (left_.Robot2Pixel(pb2, J_pb2) - ob_);
+        if (jacobians)
+        {
+            // d(pb2) / d(pw) = Rbw2
+            Matrix<double, 2, 3> J_pw = weight_ * J_pb2 * -J_pose2.rightCols<3>();
+            if (jacobians[0])
+            {
+                Eigen::Map<Vector2d> jacobian_inv_d(jacobians[0]);
+                jacobian_inv_d = J_pw * J_pb * J_inv_d;
+            }
+            if (jacobians[1])
+            {
+                Eigen::Map<Matrix<double, 2, 7, RowMajor>> jacobian_pose1(jacobians[1]);
+                jacobian_pose1 = J_pw * J_pose1;
+            }
+            if (jacobians[2])
+            {
+                Eigen::Map<Matrix<double, 2, 7, RowMajor>> jacobian_pose2(jacobians[2]);
+                jacobian_pose2 = weight_ * J_pb2 * J_pose2;
+            }
+        }
+        return true;
+    }
+
+private:
+    Vector2d first_ob_, ob_;
+    PinholeProjection left_, right_;
+    double weight_;
+};
+
+class TwoCameraReprojectionCost : public ceres::SizedCostFunction<2, 1>
+{
+public:
+    TwoCameraReprojectionCost(Vector2d left_ob, Vector2d right_ob, Camera::Ptr left, Camera::Ptr right, double weight)
+        : left_ob_(left_ob), right_ob_(right_ob), left_(left), right_(right), weight_(weight) {}
+
+    virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+    {
+        Vector3d J_inv_d;
+        Matrix<double, 2, 3> J_pb;
+        Vector3d pb = right_.Pixel2Robot(right_ob_, parameters[0][0], J_inv_d);
+        Eigen::Map<Vector2d> residual(residuals);
+        residual = weight_ * (left_.Robot2Pixel(pb, J_pb) - left_ob_);
+        if (jacobians && jacobians[0])
+        {
+            Eigen::Map<Vector2d> jacobian_inv_d(jacobians[0]);
+            jacobian_inv_d = weight_ * J_pb * J_inv_d;
+        }
+        return true;
+    }
+
+private:
+    Vector2d left_ob_, right_ob_;
+    PinholeProjection left_, right_;
+    double weight_;
+};
+
 class PoseOnlyReprojectionError : public ceres::Error
 {
 public:
@@ -65,6 +230,8 @@ public:
 
     static ceres::CostFunction *Create(Vector2d ob, Vector3d pw, Camera::Ptr camera, double weight)
     {
+        if (use_analytic_jacobian)
+            return new PoseOnlyReprojectionCost(ob, pw, camera, weight);
         return (new ceres::AutoDiffCostFunction<PoseOnlyReprojectionError, 2, 7>(
             new PoseOnlyReprojectionError(ob, pw, camera, weight)));
     }
@@ -97,6 +264,8 @@ public:
 
     static ceres::CostFunction *Create(Vector2d first_ob, Vector2d ob, Camera::Ptr left, Camera::Ptr right, double weight)
     {
+        if (use_analytic_jacobian)
+            return new TwoFrameReprojectionCost(first_ob, ob, left, right, weight);
         return (new ceres::AutoDiffCostFunction<TwoFrameReprojectionError, 2, 1, 7, 7>(
             new TwoFrameReprojectionError(first_ob, ob, left, right, weight)));
     }
@@ -127,6 +296,8 @@ public:
 
     static ceres::CostFunction *Create(Vector2d left_ob, Vector2d right_ob, Camera::Ptr left, Camera::Ptr right, double weight)
     {
+        if (use_analytic_jacobian)
+            return new TwoCameraReprojectionCost(left_ob, right_ob, left, right, weight);
         return (new ceres::AutoDiffCostFunction<TwoCameraReprojectionError, 2, 1>(
             new TwoCameraReprojectionError(left_ob, right_ob, left, right, weight)));
     }
@@ -2,6 +2,8 @@
 #define lvio_fusion_COMMON_H
 
 // std
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
@@ -12,6 +14,7 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // define the commonly included file to avoid a long include list
@@ -3,6 +3,7 @@
 #define lvio_fusion_VISUAL_ODOMETRY_H
 
 #include "lvio_fusion/backend.h"
+#include "lvio_fusion/bounded_queue.h"
 #include "lvio_fusion/common.h"
 #include "lvio_fusion/frontend.h"
 #include "lvio_fusion/imu/initializer.h"
@@ -33,6 +34,8 @@ public:
 
     Estimator(std::string &config_path);
 
+    ~Estimator();
+
     void InputImage(double time, cv::Mat &left_image, cv::Mat &right_image, SE3d init_odom);
 
     void InputNavSat(double time, double latitude, double longitude, double altitude, Vector3d cov);
@@ -40,6 +43,7 @@ public:
     void InputPointCloud(double time, Point3Cloud::Ptr point_cloud);
 
     void InputImu(double time, Vector3d acc, Vector3d gyr);
+    void InputImu(const std::vector<ImuData> &data);
 
     bool Init(int use_imu, int use_lidar, int use_navsat, int use_loop, int use_adapt);
 
@@ -51,7 +55,15 @@ public:
     Initializer::Ptr initializer;
 
 private:
+    // equalize, undistort and build the pyramid of new images
+    void Preprocess(Frame::Ptr frame, cv::Mat &left_image, cv::Mat &right_image);
+
+    // track preprocessed frames, so the next frame is preprocessed meanwhile
+    void FrontendLoop();
+
     std::string config_file_path_;
+    BoundedQueue<Frame::Ptr> frames_{2};
+    std::thread thread_frontend_;
 };
 } // namespace lvio_fusion
 
@@ -0,0 +1,208 @@
+#ifndef lvio_fusion_FLAT_MAP_H
+#define lvio_fusion_FLAT_MAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lvio_fusion
+{
+
+// sorted vector with the interface of std::map, for small maps iterated much more than modified.
+// keys are mostly inserted in increasing order, which only appends.
+// the vector is copied on write, so maps can be shared by threads:
+// iterators and copies hold a snapshot, which insertions and erasures never change.
+// modifications are serialized by a lock, and only copy the vector while a snapshot of it is held.
+template <typename Key, typename Value>
+class FlatMap
+{
+public:
+    typedef std::pair<Key, Value> value_type;
+
+private:
+    typedef std::vector<value_type> Data;
+
+public:
+    // iterator of a snapshot, which is equal to any end() once it passes the last element
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef FlatMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type *pointer;
+        typedef const value_type &reference;
+
+        const_iterator() {}
+
+        reference operator*() const { return (*data_)[index_]; }
+        pointer operator->() const { return &(*data_)[index_]; }
+
+        const_iterator &operator++()
+        {
+            index_++;
+            return *this;
+        }
+
+        const_iterator &operator--()
+        {
+            index_--;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            index_++;
+            return old;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator old = *this;
+            index_--;
+            return old;
+        }
+
+        bool operator==(const const_iterator &other) const
+        {
+            return (IsEnd() && other.IsEnd()) || (data_ == other.data_ && index_ == other.index_);
+        }
+
+        bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+    private:
+        friend class FlatMap;
+
+        const_iterator(std::shared_ptr<const Data> data, size_t index) : data_(std::move(data)), index_(index) {}
+
+        bool IsEnd() const { return !data_ || index_ >= data_->size(); }
+
+        std::shared_ptr<const Data> data_;
+        size_t index_ = 0;
+    };
+    typedef const_iterator iterator;
+
+    FlatMap() {}
+
+    FlatMap(const FlatMap &other) : data_(other.Snapshot()) {}
+
+    FlatMap &operator=(const FlatMap &other)
+    {
+        auto data = other.Snapshot();
+        std::unique_lock<std::mutex> lock(mutex_);
+        data_ = std::move(data);
+        return *this;
+    }
+
+    const_iterator begin() const { return const_iterator(Snapshot(), 0); }
+
+    const_iterator end() const
+    {
+        auto data = Snapshot();
+        size_t size = data ? data->size() : 0;
+        return const_iterator(std::move(data), size);
+    }
+
+    size_t size() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return data_ ? data_->size() : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        data_.reset();
+    }
+
+    const_iterator find(const Key &key) const
+    {
+        auto data = Snapshot();
+        if (!data)
+            return const_iterator();
+        auto iter = LowerBound(*data, key);
+        size_t index = iter != data->end() && iter->first == key ? iter - data->begin() : data->size();
+        return const_iterator(std::move(data), index);
+    }
+
+    size_t count(const Key &key) const { return find(key) != end(); }
+
+    // the same as map[key] = value
+    void insert_or_assign(const Key &key, const Value &value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Data &data = Writable();
+        if (data.empty() || data.back().first < key)
+        {
+            data.emplace_back(key, value);
+            return;
+        }
+        auto iter = LowerBound(data, key);
+        if (iter == data.end() || iter->first != key)
+        {
+            data.emplace(iter, key, value);
+        }
+        else
+        {
+            iter->second = value;
+        }
+    }
+
+    size_t erase(const Key &key)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!data_)
+            return 0;
+        auto iter = LowerBound(*data_, key);
+        if (iter == data_->end() || iter->first != key)
+            return 0;
+        size_t index = iter - data_->begin();
+        Data &data = Writable();
+        data.erase(data.begin() + index);
+        return 1;
+    }
+
+private:
+    std::shared_ptr<Data> Snapshot() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return data_;
+    }
+
+    // called with the lock, the vector is copied if a snapshot of it is held
+    Data &Writable()
+    {
+        if (!data_)
+        {
+            data_ = std::make_shared<Data>();
+        }
+        else if (data_.use_count() > 1)
+        {
+            data_ = std::make_shared<Data>(*data_);
+        }
+        // the last reads of released snapshots happen before the writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return *data_;
+    }
+
+    template <typename D>
+    static auto LowerBound(D &data, const Key &key) -> decltype(data.begin())
+    {
+        return std::lower_bound(data.begin(), data.end(), key,
+                                [](const value_type &a, const Key &b) { return a.first < b; });
+    }
+
+    std::shared_ptr<Data> data_; // null if empty, not allocated for maps never filled
+    mutable std::mutex mutex_;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_FLAT_MAP_H
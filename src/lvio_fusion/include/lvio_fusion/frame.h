@@ -8,6 +8,7 @@
 #include "lvio_fusion/lidar/feature.h"
 #include "lvio_fusion/loop/loop.h"
 #include "lvio_fusion/navsat/feature.h"
+#include "lvio_fusion/visual/extractor.h"
 #include "lvio_fusion/visual/feature.h"
 
 namespace lvio_fusion
@@ -28,20 +29,32 @@ public:
 
     void Clear();
 
+    // the right image is kept raw, and only processed for keyframes
+    void SetImageRight(const cv::Mat &raw);
+    const cv::Mat &GetImageRight();
+
+    // pyramids of optical flow, built at the first use
+    const std::vector<cv::Mat> &GetPyramidLeft();
+    const std::vector<cv::Mat> &GetPyramidRight();
+
+    // release pyramids and right images, which are only used by the current frame
+    void ReleaseBuffers();
+
     static Frame::Ptr Create();
 
     static unsigned long current_frame_id;
     unsigned long id;
     double time;
     Frame::Ptr last_keyframe;
-    cv::Mat image_left, image_right;
+    cv::Mat image_left;
+    ImagePyramid orb_pyramid;                     // pyramid of left image for orb
     visual::Features features_left;               // extracted features in left image
     visual::Features features_right;              // new landmarks features in right image 
     lidar::Feature::Ptr feature_lidar;            // extracted features in lidar point cloud
     imu::Preintegration::Ptr preintegration;      // imu pre integration from last key frame
     imu::Preintegration::Ptr preintegration_last; // imu pre integration from last frame
     navsat::Feature::Ptr feature_navsat;          // navsat point
-    cv::Mat descriptors;                          // orb descriptors
+    cv::Mat descriptors;                          // orb descriptors of the features, 32 bytes per row
     loop::LoopClosure::Ptr loop_closure;          // loop closure
     Weights weights;                              // weights of different factors
     SE3d pose;
@@ -55,6 +68,10 @@ public:
     Vector3d Vw;                // Imu linear velocity
     Bias bias;                  // Imu bias
     bool good_imu = false;   // can be used in Imu optimization?
+
+private:
+    cv::Mat image_right_, image_right_raw_;
+    std::vector<cv::Mat> pyramid_left_, pyramid_right_;
 };
 
 typedef std::map<double, Frame::Ptr> Frames;
@@ -2,6 +2,7 @@
 #define lvio_fusion_FRONTEND_H
 
 #include "lvio_fusion/common.h"
+#include "lvio_fusion/imu/integrator.h"
 #include "lvio_fusion/visual/local_map.h"
 
 namespace lvio_fusion
@@ -9,6 +10,19 @@ namespace lvio_fusion
 
 class Backend;
 
+// optimized state published by the backend, applied by the frontend at the start of its next frame
+struct BackendState
+{
+    unsigned long version = 0;
+    double time = 0;                                       // keyframes before have been optimized
+    SE3d transform;                                        // correction of frames after time
+    double init_time = 0;                                  // imu initialization started from
+    bool initialized = false;                              // imu is initialized
+    Frame::Ptr prior_frame;                                // copy of the last optimized keyframe, for imu
+    std::unordered_map<double, SE3d> poses;                // optimized keyframes
+    std::unordered_map<unsigned long, Vector3d> positions; // landmarks first observed in optimized keyframes
+};
+
 enum class FrontendStatus
 {
     BUILDING,
@@ -27,10 +41,18 @@ public:
     bool AddFrame(Frame::Ptr frame);
 
     void AddImu(double time, Vector3d acc, Vector3d gyr);
+    void AddImu(const std::vector<ImuData> &data);
+
+    // imu data before the frame are preintegrated in the background
+    void ExpectFrame(double time);
 
     void SetBackend(std::shared_ptr<Backend> backend) { backend_ = backend; }
 
-    void UpdateCache();
+    // apply the last state of the backend, the caller holds the mutex
+    void UpdateState();
+
+    void UpdateCache(const std::unordered_map<double, SE3d> &poses = {},
+                     const std::unordered_map<unsigned long, Vector3d> &positions = {});
 
     void UpdateImu(const Bias &bias_);
 
@@ -65,7 +87,8 @@ private:
 
     // data
     std::weak_ptr<Backend> backend_;
-    std::queue<ImuData> imu_buf_;
+    BackendState state_;
+    imu::Integrator imu_integrator_;
     imu::Preintegration::Ptr preintegration_last_kf_; // imu pre integration from last key frame
     SE3d last_frame_pose_cache_;
     SE3d relative_i_j_;
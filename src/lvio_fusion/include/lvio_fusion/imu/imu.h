@@ -64,7 +64,7 @@ public:
     double ACC_N, ACC_W;
     double GYR_N, GYR_W;
     double G;
-    bool initialized = false;
+    std::atomic<bool> initialized{false}; // set by the frontend, read by the backend
 
 private:
     Imu(const SE3d &extrinsic, double acc_n, double acc_w, double gyr_n, double gyr_w, double g_norm) : Sensor(extrinsic), ACC_N(acc_n), ACC_W(acc_w), GYR_N(gyr_n), GYR_W(gyr_w), G(g_norm) {  }
@@ -0,0 +1,47 @@
+#ifndef lvio_fusion_IMU_BUFFER_H
+#define lvio_fusion_IMU_BUFFER_H
+
+#include "lvio_fusion/common.h"
+#include "lvio_fusion/imu/imu.h"
+
+#include <atomic>
+
+namespace lvio_fusion
+{
+
+// lock-free ring buffer of imu data, with one producer and one consumer.
+// data are sorted by time, so they can be searched by timestamp.
+// the consumer sleeps on a condition until new data arrive.
+class ImuBuffer
+{
+public:
+    // called by the producer, data out of order or overflowed are dropped
+    bool Push(const ImuData &data);
+    int Push(const std::vector<ImuData> &data);
+
+    /**
+     * called by the consumer, pop data before end which have arrived, wait if there are none
+     * @param start     start time, data before it are dropped
+     * @param end       end time
+     * @param timeout   max seconds to wait for new data
+     * @param out       data in [start, end), and the first data after end if it has arrived, which is not popped
+     */
+    void Pop(double start, double end, double timeout, std::vector<ImuData> &out);
+
+private:
+    // index of the first data not earlier than time, in [head, tail)
+    size_t LowerBound(size_t head, size_t tail, double time) const;
+
+    static const size_t capacity_ = 1 << 14;
+    ImuData buffer_[capacity_];
+    std::atomic<size_t> head_{0}, tail_{0};
+    double last_time_ = 0; // only used by the producer
+
+    std::atomic<bool> waiting_{false};
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_IMU_BUFFER_H
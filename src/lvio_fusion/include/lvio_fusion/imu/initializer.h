@@ -13,16 +13,23 @@ class Initializer
 public:
     typedef std::shared_ptr<Initializer> Ptr;
 
-    void Initialize(double init_time, double end_time);
+    /**
+     * initialize imu with keyframes between init_time and end_time
+     * @param initialized   input and output, imu is initialized, applied to Imu by the frontend
+     * @param transform     output, correction of frames after end_time
+     * @return true if initialized this time
+     */
+    bool Initialize(double init_time, double end_time, bool &initialized, SE3d &transform);
 
     int step = 1;   // 1,2,3: next step 1,2,3; 4: finish;
 
 private:
-    void EstimateVelAndRwg(Frames keyframes);
+    void EstimateVelAndRwg(const FramesView &keyframes);
 
-    bool Initialize(Frames frames, double prior_a, double prior_g);
+    bool Initialize(const FramesView &frames, double prior_a, double prior_g);
 
     Matrix3d Rwg_;  // R of gravity in world frame
+    bool initialized_ = false;
     const int num_frames_init = 10;
 };
 
@@ -0,0 +1,77 @@
+#ifndef lvio_fusion_INTEGRATOR_H
+#define lvio_fusion_INTEGRATOR_H
+
+#include "lvio_fusion/common.h"
+#include "lvio_fusion/imu/imu_buffer.h"
+#include "lvio_fusion/imu/preintegration.h"
+
+namespace lvio_fusion
+{
+
+namespace imu
+{
+
+// preintegrate imu data between frames in the background, as soon as they arrive.
+// the frontend only takes the results, from the last frame and from the last keyframe,
+// after the last step to the frame is appended.
+// at most one frame is preintegrated ahead of the frontend, because the preintegration
+// from the last keyframe depends on whether the last frame becomes a keyframe.
+class Integrator
+{
+public:
+    Integrator();
+    ~Integrator();
+
+    void AddImu(const ImuData &data) { buffer_.Push(data); }
+    void AddImu(const std::vector<ImuData> &data) { buffer_.Push(data); }
+
+    // time of a coming frame, preintegrations end at frames
+    void AddFrame(double time);
+
+    /**
+     * take the preintegrations ending at the frame
+     * @param time                  time of the frame
+     * @param bias                  bias of the last frame
+     * @param restart               preintegrate from the last frame again, as it is a new keyframe
+     * @param timeout               max seconds to wait
+     * @param preintegration_last   output, preintegration from the last frame
+     * @param preintegration        output, preintegration from the last keyframe
+     * @return false if imu data are not enough
+     */
+    bool Take(double time, const Bias &bias, bool restart, double timeout,
+              Preintegration::Ptr &preintegration_last, Preintegration::Ptr &preintegration);
+
+private:
+    // preintegration from frames_[0] to frames_[1]
+    struct Progress
+    {
+        double start = -1, end = -1;
+        int n = 0;              // number of data in [start, end)
+        ImuData previous, next; // the last data before end, and the first data after end
+        bool complete = false;  // only the step to end is left
+        Preintegration::Ptr last;
+    };
+
+    void IntegratorLoop();
+
+    // append data in [start, end) to the preintegrations in progress
+    void Append(const ImuData &data);
+
+    ImuBuffer buffer_;
+    std::deque<double> frames_; // frames_[0] is the start of the next preintegration
+    double allowed_start_;      // the next preintegration should not start later
+    Bias bias_;                 // bias of the next preintegration
+    Preintegration::Ptr keyframe_; // only owned by the integrator, copies are taken
+    Progress progress_;
+
+    bool running_ = true;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread thread_;
+};
+
+} // namespace imu
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_INTEGRATOR_H
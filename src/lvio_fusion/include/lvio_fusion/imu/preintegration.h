@@ -58,6 +58,11 @@ public:
         const Vector3d &Pi, const Quaterniond &Qi, const Vector3d &Vi, const Vector3d &Bai, const Vector3d &Bgi,
         const Vector3d &Pj, const Quaterniond &Qj, const Vector3d &Vj, const Vector3d &Baj, const Vector3d &Bgj, const Quaterniond &Rg);
 
+    // square root of the information, cached until the covariance changes
+    Matrix<double, 15, 15> GetSqrtInformation();
+    // replace the information of bias by priors
+    Matrix<double, 15, 15> GetSqrtInformation(double prior_a, double prior_g);
+
     Vector3d GetUpdatedDeltaVelocity();
     void UpdateBias(const Bias &new_bias);
     Quaterniond GetUpdatedDeltaRotation();
@@ -83,11 +88,23 @@ public:
     Matrix<double, 15, 15> jacobian, covariance;
     Matrix<double, 15, 15> step_jacobian;
     Matrix<double, 15, 18> step_V;
-    Matrix<double, 18, 18> noise;
+    Vector4d noise; // variances of acc, gyr, acc bias and gyr bias
 
 private:
+    struct SqrtInformation
+    {
+        bool with_prior;
+        double prior_a, prior_g;
+        Matrix<double, 15, 15> matrix;
+    };
+
     Preintegration() = default;
     Preintegration(const Vector3d &_linearized_ba, const Vector3d &_linearized_bg);
+
+    Matrix<double, 15, 15> GetSqrtInformation(bool with_prior, double prior_a, double prior_g);
+
+    // evaluated by threads of the solver, accessed atomically
+    std::shared_ptr<const SqrtInformation> sqrt_info_;
 };
 
 typedef std::map<double, Preintegration::Ptr> PreIntegrations;
@@ -2,19 +2,20 @@
 #define lvio_fusion_IMU_TOOLS_H
 #include "lvio_fusion/common.h"
 #include "lvio_fusion/frame.h"
+#include "lvio_fusion/map.h"
 namespace lvio_fusion
 {
 
 namespace imu
 {
 
-void RePredictVel(Frames &frames, Frame::Ptr &prior_frame);
+void RePredictVel(const Frames &frames, Frame::Ptr &prior_frame);
 
-bool InertialOptimization(Frames &frames, Matrix3d &Rwg, double prior_a, double prior_g);
+bool InertialOptimization(const FramesView &frames, Matrix3d &Rwg, double prior_a, double prior_g);
 
-void FullBA(Frames &frames, double prior_a, double prior_g);
+void FullBA(const FramesView &frames, double prior_a, double prior_g);
 
-void RecoverBias(Frames &frames);
+void RecoverBias(const FramesView &frames);
 
 } // namespace imu
 
@@ -3,6 +3,7 @@
 
 #include "lvio_fusion/common.h"
 #include "lvio_fusion/lidar/association.h"
+#include "lvio_fusion/map.h"
 
 namespace lvio_fusion
 {
@@ -16,7 +17,7 @@ public:
 
     void SetFeatureAssociation(FeatureAssociation::Ptr association) { association_ = association; }
 
-    void Optimize(Frames &active_kfs);
+    void Optimize(const FramesView &active_kfs);
 
     void BuildOldMapFrame(Frame::Ptr old_frame, Frame::Ptr map_frame);
 
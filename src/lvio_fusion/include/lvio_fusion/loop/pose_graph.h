@@ -56,7 +56,8 @@ public:
 
     void ForwardUpdate(SE3d transfrom, double start_time, bool need_lock = true);
 
-    void ForwardUpdate(SE3d transfrom, const Frames &forward_kfs);
+    // new pose = transform * old pose, also of the last frame of the frontend if it is given and not a keyframe
+    void ForwardUpdate(SE3d transfrom, const FramesView &forward_kfs, Frame::Ptr last_frame = nullptr);
 
     std::mutex mutex;
     Section current_section;
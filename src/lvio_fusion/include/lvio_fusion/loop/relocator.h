@@ -45,7 +45,7 @@ private:
     bool RelocateByPoints(Frame::Ptr frame, Frame::Ptr old_frame);
     void CorrectLoop(double old_time, double start_time, double end_time);
 
-    void UpdateNewSubmap(Frame::Ptr best_frame, Frames &new_submap_kfs);
+    void UpdateNewSubmap(Frame::Ptr best_frame, const FramesView &new_submap_kfs);
 
     Mapping::Ptr mapping_;
     Backend::Ptr backend_;
@@ -8,6 +8,98 @@
 namespace lvio_fusion
 {
 
+// keyframes arrive in time order and are only appended, into chunks which are reserved
+// at creation and never reallocate. a snapshot is the list of chunks and the number of
+// keyframes at the moment, so the map never copies keyframes and views never copy.
+typedef std::vector<Frames::value_type> FramesChunk;
+typedef std::vector<std::shared_ptr<FramesChunk>> FramesChunks;
+
+class FramesIterator
+{
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef Frames::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef const value_type &reference;
+
+    static const size_t chunk_size = 1024;
+
+    FramesIterator() {}
+    FramesIterator(const FramesChunks *chunks, size_t index) : chunks_(chunks), index_(index) {}
+
+    reference operator*() const { return (*(*chunks_)[index_ / chunk_size])[index_ % chunk_size]; }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    FramesIterator &operator++() { ++index_; return *this; }
+    FramesIterator &operator--() { --index_; return *this; }
+    FramesIterator operator++(int) { return FramesIterator(chunks_, index_++); }
+    FramesIterator operator--(int) { return FramesIterator(chunks_, index_--); }
+    FramesIterator &operator+=(difference_type n) { index_ += n; return *this; }
+    FramesIterator &operator-=(difference_type n) { index_ -= n; return *this; }
+    FramesIterator operator+(difference_type n) const { return FramesIterator(chunks_, index_ + n); }
+    FramesIterator operator-(difference_type n) const { return FramesIterator(chunks_, index_ - n); }
+    difference_type operator-(const FramesIterator &other) const { return (difference_type)index_ - (difference_type)other.index_; }
+
+    bool operator==(const FramesIterator &other) const { return index_ == other.index_; }
+    bool operator!=(const FramesIterator &other) const { return index_ != other.index_; }
+    bool operator<(const FramesIterator &other) const { return index_ < other.index_; }
+    bool operator>(const FramesIterator &other) const { return index_ > other.index_; }
+    bool operator<=(const FramesIterator &other) const { return index_ <= other.index_; }
+    bool operator>=(const FramesIterator &other) const { return index_ >= other.index_; }
+
+private:
+    const FramesChunks *chunks_ = nullptr;
+    size_t index_ = 0;
+};
+
+// range of keyframes in a snapshot of the map, the snapshot is kept alive by the view.
+class FramesView
+{
+public:
+    typedef FramesIterator const_iterator;
+    typedef const_iterator iterator;
+
+    FramesView() : FramesView(std::make_shared<const FramesChunks>(), 0) {}
+
+    FramesView(std::shared_ptr<const FramesChunks> chunks, size_t size)
+        : chunks_(chunks), begin_(chunks.get(), 0), end_(chunks.get(), size) {}
+
+    FramesView(const FramesView &view, const_iterator begin, const_iterator end)
+        : chunks_(view.chunks_), begin_(begin), end_(end) {}
+
+    const_iterator begin() const { return begin_; }
+    const_iterator end() const { return end_; }
+    bool empty() const { return begin_ == end_; }
+    size_t size() const { return end_ - begin_; }
+
+    const_iterator lower_bound(double time) const
+    {
+        return std::lower_bound(begin_, end_, time, [](const Frames::value_type &pair, double time) { return pair.first < time; });
+    }
+
+    const_iterator upper_bound(double time) const
+    {
+        return std::upper_bound(begin_, end_, time, [](double time, const Frames::value_type &pair) { return time < pair.first; });
+    }
+
+    const_iterator find(double time) const
+    {
+        auto iter = lower_bound(time);
+        return iter != end_ && iter->first == time ? iter : end_;
+    }
+
+    size_t count(double time) const { return find(time) != end_; }
+
+    // copy for callers which add or remove frames
+    operator Frames() const { return Frames(begin_, end_); }
+
+private:
+    std::shared_ptr<const FramesChunks> chunks_;
+    const_iterator begin_, end_;
+};
+
 class Map
 {
 public:
@@ -21,11 +113,17 @@ public:
 
     int size()
     {
-        return keyframes.size();
+        return Snapshot().size();
+    }
+
+    // all keyframes at the moment, O(1)
+    FramesView Snapshot()
+    {
+        return *std::atomic_load(&keyframes_);
     }
 
     Frame::Ptr GetKeyFrame(double time);
-    Frames GetKeyFrames(double start, double end = 0, int num = 0);
+    FramesView GetKeyFrames(double start, double end = 0, int num = 0);
 
     void InsertKeyFrame(Frame::Ptr frame);
 
@@ -35,21 +133,28 @@ public:
 
     SE3d ComputePose(double time);
 
-    void ApplyGravityRotation(const Matrix3d &R);
+    // rotate keyframes until end_time, later ones belong to the frontend
+    void ApplyGravityRotation(const Matrix3d &R, double end_time);
 
     void Reset()
     {
+        std::unique_lock<std::mutex> lock(mutex_local_kfs);
         landmarks.clear();
-        keyframes.clear();
+        chunks_ = std::make_shared<FramesChunks>();
+        std::atomic_store(&keyframes_, std::make_shared<const FramesView>());
     }
-    
+
     std::mutex mutex_local_kfs;
-    Frames keyframes;
     visual::Landmarks landmarks;
     bool end = false;
 
 private:
-    Map() {}
+    Map() : chunks_(std::make_shared<FramesChunks>()), keyframes_(std::make_shared<const FramesView>()) {}
+
+    // chunks of keyframes, the list is copied when a chunk is added, and the chunks are shared
+    std::shared_ptr<FramesChunks> chunks_;
+    // view of all keyframes, replaced at insertion, readers hold the old one as long as they need
+    std::shared_ptr<const FramesView> keyframes_;
     Map(const Map &);
     Map &operator=(const Map &);
 };
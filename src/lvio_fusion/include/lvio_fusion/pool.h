@@ -0,0 +1,376 @@
+#ifndef lvio_fusion_POOL_H
+#define lvio_fusion_POOL_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+// fixed size blocks carved from big slabs, freed blocks are reused by free lists.
+// every thread has its own cache of free blocks, so most calls take no lock,
+// only batches of blocks move between the caches and the shared list.
+// slabs are never returned to the system.
+template <size_t Size>
+class Slab
+{
+public:
+    static void *Allocate()
+    {
+        if (exited_)
+        {
+            Cache cache;
+            return cache.Take();
+        }
+        return LocalCache().Take();
+    }
+
+    // blocks may be freed by another thread than the one allocated them
+    static void Deallocate(void *p)
+    {
+        if (exited_)
+        {
+            Cache cache;
+            cache.Put(p);
+            return;
+        }
+        LocalCache().Put(p);
+    }
+
+private:
+    union Block {
+        Block *next;
+        alignas(16) char data[Size];
+    };
+
+    static const int batch_size = 256;
+    static const int slab_size = 16 * batch_size;
+
+    // free blocks of a thread, given back when the thread exits
+    struct Cache
+    {
+        ~Cache()
+        {
+            if (free)
+            {
+                Instance().Push(free, num);
+            }
+            exited_ = true;
+        }
+
+        void *Take()
+        {
+            if (!free)
+            {
+                Instance().Pop(*this);
+            }
+            Block *block = free;
+            free = block->next;
+            num--;
+            return block;
+        }
+
+        void Put(void *p)
+        {
+            Block *block = static_cast<Block *>(p);
+            block->next = free;
+            free = block;
+            if (++num == 2 * batch_size)
+            {
+                // give a batch back, keep the other one
+                Block *last = free;
+                for (int i = 1; i < batch_size; i++)
+                {
+                    last = last->next;
+                }
+                Block *batch = free;
+                free = last->next;
+                last->next = nullptr;
+                num = batch_size;
+                Instance().Push(batch, batch_size);
+            }
+        }
+
+        Block *free = nullptr;
+        int num = 0;
+    };
+
+    // never destroyed, objects may be released after static destructors
+    static Slab &Instance()
+    {
+        static Slab *slab = new Slab;
+        return *slab;
+    }
+
+    static Cache &LocalCache()
+    {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    // move a batch to an empty cache
+    void Pop(Cache &cache)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (batches_.empty())
+        {
+            Grow();
+        }
+        cache.free = batches_.back().first;
+        cache.num = batches_.back().second;
+        batches_.pop_back();
+    }
+
+    // a list of num blocks
+    void Push(Block *batch, int num)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        batches_.emplace_back(batch, num);
+    }
+
+    void Grow()
+    {
+        slabs_.emplace_back(new Block[slab_size]);
+        Block *blocks = slabs_.back().get();
+        for (int i = 0; i < slab_size; i++)
+        {
+            blocks[i].next = (i + 1) % batch_size ? &blocks[i + 1] : nullptr;
+            if (i % batch_size == 0)
+            {
+                batches_.emplace_back(&blocks[i], batch_size);
+            }
+        }
+    }
+
+    // the cache of this thread has been destroyed, blocks go to the shared list directly
+    static thread_local bool exited_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Block[]>> slabs_;
+    std::vector<std::pair<Block *, int>> batches_;
+};
+
+template <size_t Size>
+const int Slab<Size>::batch_size;
+
+template <size_t Size>
+const int Slab<Size>::slab_size;
+
+template <size_t Size>
+thread_local bool Slab<Size>::exited_ = false;
+
+// allocator for std::allocate_shared, the object and its control block share one block
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        static_assert(alignof(T) <= 16, "over-aligned types are not supported");
+        if (n != 1)
+            return std::allocator<T>().allocate(n);
+        return static_cast<T *>(Slab<sizeof(T)>::Allocate());
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n != 1)
+            return std::allocator<T>().deallocate(p, n);
+        Slab<sizeof(T)>::Deallocate(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) { return false; }
+
+template <typename T>
+class Handle;
+
+// objects referred to by handles of the index and the generation of their slot,
+// instead of weak pointers. objects are owned by shared pointers as before,
+// the generation of a slot changes when its object is destroyed, so handles expire like weak pointers,
+// but checking a handle takes no atomic reference counting.
+// objects and their control blocks are in slabs, slots are never returned to the system.
+template <typename T>
+class HandleStore
+{
+public:
+    template <typename... Args>
+    static std::shared_ptr<T> Create(Args &&... args)
+    {
+        HandleStore &store = Instance();
+        unsigned int index = store.Take();
+        Slot &slot = store.At(index);
+        T *object = new (PoolAllocator<T>().allocate(1)) T(std::forward<Args>(args)...);
+        std::shared_ptr<T> ptr(object, Deleter{index}, PoolAllocator<T>());
+        SpinLock lock(slot.busy);
+        slot.object = object;
+        slot.weak = ptr;
+        return ptr;
+    }
+
+private:
+    friend class Handle<T>;
+
+    static const int chunk_size = 4096;
+    static const int max_chunks = 4096;
+
+    struct Slot
+    {
+        std::atomic<unsigned int> generation{0};
+        std::atomic_flag busy = ATOMIC_FLAG_INIT; // guards weak, only held for a few instructions
+        T *object = nullptr;
+        std::weak_ptr<T> weak;
+    };
+
+    class SpinLock
+    {
+    public:
+        explicit SpinLock(std::atomic_flag &flag) : flag_(flag)
+        {
+            while (flag_.test_and_set(std::memory_order_acquire))
+                ;
+        }
+
+        ~SpinLock() { flag_.clear(std::memory_order_release); }
+
+    private:
+        std::atomic_flag &flag_;
+    };
+
+    // handles of the object expire before it is destroyed
+    struct Deleter
+    {
+        void operator()(T *object) const
+        {
+            HandleStore &store = Instance();
+            Slot &slot = store.At(index);
+            {
+                SpinLock lock(slot.busy);
+                slot.generation.fetch_add(1, std::memory_order_release);
+                slot.weak.reset();
+            }
+            object->~T();
+            PoolAllocator<T>().deallocate(object, 1);
+            store.Put(index);
+        }
+
+        unsigned int index;
+    };
+
+    HandleStore()
+    {
+        for (auto &chunk : chunks_)
+        {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // never destroyed, objects may be released after static destructors
+    static HandleStore &Instance()
+    {
+        static HandleStore *store = new HandleStore;
+        return *store;
+    }
+
+    // chunks are never moved, so slots are read without the lock
+    Slot &At(unsigned int index) const
+    {
+        return chunks_[index / chunk_size].load(std::memory_order_acquire)[index % chunk_size];
+    }
+
+    unsigned int Take()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!free_.empty())
+        {
+            unsigned int index = free_.back();
+            free_.pop_back();
+            return index;
+        }
+        if (size_ % chunk_size == 0)
+        {
+            assert(size_ / chunk_size < max_chunks);
+            chunks_[size_ / chunk_size].store(new Slot[chunk_size], std::memory_order_release);
+        }
+        return size_++;
+    }
+
+    void Put(unsigned int index)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_.push_back(index);
+    }
+
+    std::atomic<Slot *> chunks_[max_chunks];
+    std::mutex mutex_;
+    std::vector<unsigned int> free_;
+    unsigned int size_ = 0;
+};
+
+template <typename T>
+const int HandleStore<T>::chunk_size;
+
+template <typename T>
+const int HandleStore<T>::max_chunks;
+
+// weak reference to an object of HandleStore, with the interface of std::weak_ptr.
+// get() takes no reference, the object must be owned by others while it is used,
+// lock() takes one as weak_ptr::lock() does.
+template <typename T>
+class Handle
+{
+public:
+    Handle() {}
+
+    Handle(const std::shared_ptr<T> &object)
+    {
+        if (!object)
+            return;
+        auto deleter = std::get_deleter<typename HandleStore<T>::Deleter>(object);
+        assert(deleter);
+        index_ = deleter->index;
+        generation_ = HandleStore<T>::Instance().At(index_).generation.load(std::memory_order_acquire);
+    }
+
+    // null if expired
+    T *get() const
+    {
+        if (index_ == null_index)
+            return nullptr;
+        auto &slot = HandleStore<T>::Instance().At(index_);
+        return slot.generation.load(std::memory_order_acquire) == generation_ ? slot.object : nullptr;
+    }
+
+    std::shared_ptr<T> lock() const
+    {
+        if (index_ == null_index)
+            return nullptr;
+        auto &slot = HandleStore<T>::Instance().At(index_);
+        typename HandleStore<T>::SpinLock lock(slot.busy);
+        return slot.generation.load(std::memory_order_relaxed) == generation_ ? slot.weak.lock() : nullptr;
+    }
+
+    bool expired() const { return !get(); }
+
+private:
+    static const unsigned int null_index = -1;
+
+    unsigned int index_ = null_index, generation_ = 0;
+};
+
+template <typename T>
+const unsigned int Handle<T>::null_index;
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_POOL_H
@@ -5,12 +5,16 @@
 #include "lvio_fusion/common.h"
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
 #include <opencv2/core/eigen.hpp>
 
 namespace lvio_fusion
 {
 
+// run body(i) for i in [0, n) on the opencv thread pool
+void parallel_for(int n, const std::function<void(int)> &body);
+
 // *******************************Visual*******************************
 /**
  * linear triangulation with SVD
@@ -22,6 +26,20 @@ namespace lvio_fusion
  */
 void triangulate(const SE3d &pose0, const SE3d &pose1, const Vector3d &p0, const Vector3d &p1, Vector3d &p_3d);
 
+/**
+ * triangulate points in batch, by the midpoints of the closest rays
+ * @param pose0     pose of view 0,
+ * @param pose1     pose of view 1,
+ * @param x0        x of points in normalized plane of view 0
+ * @param y0        y of points in normalized plane of view 0
+ * @param x1        x of points in normalized plane of view 1
+ * @param y1        y of points in normalized plane of view 1
+ * @param depths    depths in view 0, 0 if rays are parallel
+ */
+void triangulate(const SE3d &pose0, const SE3d &pose1,
+                 const ArrayXd &x0, const ArrayXd &y0, const ArrayXd &x1, const ArrayXd &y1,
+                 ArrayXd &depths);
+
 double cv_distance(cv::Point2f &pt1, cv::Point2f &pt2);
 
 /**
@@ -36,6 +54,21 @@ void optical_flow(cv::Mat &prevImg, cv::Mat &nextImg,
                   std::vector<cv::Point2f> &prevPts, std::vector<cv::Point2f> &nextPts,
                   std::vector<uchar> &status);
 
+/**
+ * double calculate optical flow on prebuilt pyramids
+ * @param prevPyr     pyramid of prev image, see build_optical_flow_pyramid()
+ * @param nextPyr     pyramid of next image
+ * @param prevPts     point in prev image
+ * @param nextPts     point in next image
+ * @param status      status
+ */
+void optical_flow(const std::vector<cv::Mat> &prevPyr, const std::vector<cv::Mat> &nextPyr,
+                  std::vector<cv::Point2f> &prevPts, std::vector<cv::Point2f> &nextPts,
+                  std::vector<uchar> &status);
+
+// build the pyramid with gradients used by optical_flow()
+void build_optical_flow_pyramid(const cv::Mat &img, std::vector<cv::Mat> &pyramid);
+
 inline Vector2d cv2eigen(const cv::Point2f &p) { return Vector2d(p.x, p.y); }
 inline Vector3d cv2eigen(const cv::Point3f &p) { return Vector3d(p.x, p.y, p.z); }
 inline cv::Point2f eigen2cv(const Vector2d &p) { return cv::Point2f(p.x(), p.y()); }
@@ -139,6 +172,17 @@ inline Matrix<typename Derived::Scalar, 4, 4> q_right(const QuaternionBase<Deriv
     return ans;
 }
 
+// jacobian of EigenQuaternionParameterization, the rotation is perturbed on the left by twice the delta
+inline Matrix<double, 4, 3> quaternion_plus_jacobian(const double *q)
+{
+    Matrix<double, 4, 3> J;
+    J << q[3], q[2], -q[1],
+        -q[2], q[3], q[0],
+        q[1], -q[0], q[3],
+        -q[0], -q[1], -q[2];
+    return J;
+}
+
 template <typename Derived>
 inline Matrix<typename Derived::Scalar, 3, 3> ypr2R(const MatrixBase<Derived> &ypr)
 {
@@ -76,6 +76,22 @@ public:
         return Sensor2Pixel(Robot2Sensor(pw));
     }
 
+    // undistort by fixed-point remap tables, computed at the first use
+    void Undistort(const cv::Mat &src, cv::Mat &dst)
+    {
+        if (k1 == 0 && k2 == 0 && p1 == 0 && p2 == 0)
+        {
+            dst = src;
+            return;
+        }
+        if (map_size_ != src.size())
+        {
+            map_size_ = src.size();
+            cv::initUndistortRectifyMap(K, D, cv::Mat(), K, map_size_, CV_16SC2, map_[0], map_[1]);
+        }
+        cv::remap(src, dst, map_[0], map_[1], cv::INTER_LINEAR);
+    }
+
     static double baseline;
     double fx = 0, fy = 0, cx = 0, cy = 0; // Camera intrinsics
     double k1 = 0, k2 = 0, p1 = 0, p2 = 0; // Camera intrinsics
@@ -91,6 +107,9 @@ private:
     Camera(const Camera &);
     Camera &operator=(const Camera &);
 
+    cv::Size map_size_;
+    cv::Mat map_[2]; // undistortion maps
+
     static std::vector<Camera::Ptr> devices_;
 };
 
@@ -7,30 +7,60 @@ namespace lvio_fusion
 {
 
 // from ORB_SLAM2
-class QuadTreeNode
+struct QuadTreeNode
 {
-public:
-    QuadTreeNode() : no_more(false) {}
-
-    void DivideNode(QuadTreeNode &n1, QuadTreeNode &n2, QuadTreeNode &n3, QuadTreeNode &n4);
+    int Size() const { return end - begin; }
 
-    std::vector<cv::KeyPoint> kps;
     cv::Point2i UL, UR, BL, BR;
-    std::list<QuadTreeNode>::iterator iter;
+    int begin, end; // range in QuadTree::indices
+    int prev, next; // linked list in QuadTree::nodes
     bool no_more;
 };
 
+// quad tree in a flat arena, nodes only hold indices of keypoints
+class QuadTree
+{
+public:
+    QuadTree(const std::vector<cv::KeyPoint> &kps, int num_init_nodes, float width, int height);
+
+    int PushFront(const QuadTreeNode &node);
+
+    void Erase(int i);
+
+    void DivideNode(int i, QuadTreeNode children[4]);
+
+    int Begin() const { return head_; }
+
+    int Size() const { return size_; }
+
+    std::vector<QuadTreeNode> nodes;
+    std::vector<int> indices;
+
+private:
+    const std::vector<cv::KeyPoint> &kps_;
+    std::vector<int> buffer_;
+    int head_, size_;
+};
+
+// scale pyramid of ORB, levels are views of bordered images
+struct ImagePyramid
+{
+    std::vector<cv::Mat> images;
+    std::vector<cv::Mat> blurred; // for descriptors
+};
+
 class Extractor
 {
 public:
     Extractor(int nfeatures = 500, float scaleFactor = 1.2, int nlevels = 4, int iniThFAST = 14, int minThFAST = 7, int patchSize = 31, int edgeThreshold = 31);
 
-    // detect the ORB features on an image.
+    // detect the ORB features on an image, and build its pyramid.
     // ORB are dispersed on the image using an quad tree.
-    void Detect(cv::Mat image, std::vector<std::vector<cv::KeyPoint>> &keypoints);
+    void Detect(cv::Mat image, ImagePyramid &pyramid, std::vector<std::vector<cv::KeyPoint>> &keypoints);
 
-    // compute the ORB descriptors after detecting.
-    cv::Mat Compute(std::vector<std::vector<cv::KeyPoint>> &keypoints);
+    // compute the ORB descriptors on the pyramid after detecting.
+    // descriptors are in one contiguous block, and rows are aligned to 32 bytes.
+    cv::Mat Compute(const ImagePyramid &pyramid, std::vector<std::vector<cv::KeyPoint>> &keypoints);
 
     const int num_features;
     const double scale_factor;
@@ -42,9 +72,9 @@ public:
     const int edge_thershold;
 
 private:
-    void ComputePyramid(cv::Mat image);
+    void ComputePyramid(cv::Mat image, ImagePyramid &pyramid);
 
-    void ComputeKeyPointsQuadTree(std::vector<std::vector<cv::KeyPoint>> &keypoints);
+    void ComputeKeyPointsQuadTree(const ImagePyramid &pyramid, std::vector<std::vector<cv::KeyPoint>> &keypoints);
 
     std::vector<cv::KeyPoint> DistributeQuadTree(
         const std::vector<cv::KeyPoint> &vToDistributeKeys,
@@ -55,13 +85,15 @@ private:
     void ComputeOrientation(const cv::Mat &image, std::vector<cv::KeyPoint> &keypoints);
     float ICAngle(const cv::Mat &image, cv::Point2f pt);
 
+    void ComputeBRIEF(const cv::Mat &image, const cv::KeyPoint &kp, float scale, uchar *descriptor);
+
     std::vector<int> umax_;
     std::vector<float> scale_factor_per_levels_;
     std::vector<float> inv_scale_factor_per_levels_;
     std::vector<float> sigma2_per_levels_;
     std::vector<float> inv_sigma2_per_levels_;
     std::vector<int> num_desired_features_;
-    std::vector<cv::Mat> image_pyramid_;
+    std::vector<float> pattern_x_, pattern_y_;
 };
 
 } //namespace lvio_fusion
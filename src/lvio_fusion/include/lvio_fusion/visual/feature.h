@@ -2,12 +2,12 @@
 #define lvio_fusion_VISUAL_FEATURE_H
 
 #include "lvio_fusion/common.h"
+#include "lvio_fusion/flat_map.h"
+#include "lvio_fusion/pool.h"
 
 namespace lvio_fusion
 {
 
-typedef std::bitset<256> BRIEF;
-
 class Frame;
 
 namespace visual
@@ -22,28 +22,34 @@ public:
 
     Feature() {}
 
-    static Feature::Ptr Create(std::shared_ptr<Frame> frame, const cv::KeyPoint &keypoint, std::shared_ptr<Landmark> landmark = nullptr)
+    static Feature::Ptr Create(std::shared_ptr<Frame> frame, const cv::KeyPoint &keypoint, Handle<Landmark> landmark = Handle<Landmark>())
     {
-        Feature::Ptr new_feature(new Feature);
+        Feature::Ptr new_feature = std::allocate_shared<Feature>(PoolAllocator<Feature>());
         new_feature->frame = frame;
         new_feature->keypoint = keypoint;
-        if (landmark)
-        {
-            new_feature->landmark = landmark;
-        }
+        new_feature->landmark = landmark;
         return new_feature;
     }
 
     cv::KeyPoint keypoint;
     std::weak_ptr<Frame> frame;
-    std::weak_ptr<Landmark> landmark;
-    BRIEF brief;
+    Handle<Landmark> landmark; // landmarks are owned by the maps
+    int descriptor = -1; // row of descriptor in Frame::descriptors
     bool match = false;
     bool insert = false;
     bool is_on_left_image = true;
 };
 
-typedef std::map<unsigned long, Feature::Ptr> Features;
+#ifdef LVIO_FUSION_NODE_FEATURES
+// the node based map which FlatMap replaced, only built by benchmark/backend_bench to compare with
+class Features : public std::map<unsigned long, Feature::Ptr>
+{
+public:
+    void insert_or_assign(unsigned long key, const Feature::Ptr &feature) { (*this)[key] = feature; }
+};
+#else
+typedef FlatMap<unsigned long, Feature::Ptr> Features;
+#endif
 } // namespace visual
 
 } // namespace lvio_fusion
@@ -0,0 +1,57 @@
+#ifndef lvio_fusion_GRID_H
+#define lvio_fusion_GRID_H
+
+#include "lvio_fusion/common.h"
+#include "lvio_fusion/visual/feature.h"
+
+namespace lvio_fusion
+{
+
+// the best two hamming distances of candidates
+struct HammingMatch
+{
+    int best = INT_MAX, second = INT_MAX;
+    const visual::Feature::Ptr *feature = nullptr; // feature of the best
+};
+
+// spatial grid index of the features on one level.
+// features are sorted by cells, so each row of cells in a circle is a contiguous span.
+class FeatureGrid
+{
+public:
+    /**
+     * build the grid of features
+     * @param features      features on the level
+     * @param descriptors   descriptors of the frame, features refer to its rows
+     * @param size          size of the image
+     * @param cell_size     size of a cell
+     */
+    void Build(const std::vector<visual::Feature::Ptr> &features, const cv::Mat &descriptors, cv::Size size, float cell_size);
+
+    /**
+     * search the features in a circle, and keep the best two matches
+     * @param pt            center of the circle
+     * @param radius        radius of the circle
+     * @param angle         angle of the keypoint
+     * @param max_rotate    max difference of angles
+     * @param descriptor    256 bits descriptor
+     * @param match         the best two matches, accumulated between calls
+     */
+    void Search(cv::Point2f pt, float radius, float angle, float max_rotate,
+                const uint64_t *descriptor, HammingMatch &match) const;
+
+private:
+    int CellX(float x) const { return std::min(cols_ - 1, std::max(0, (int)(x * inv_cell_size_))); }
+    int CellY(float y) const { return std::min(rows_ - 1, std::max(0, (int)(y * inv_cell_size_))); }
+
+    float inv_cell_size_ = 1;
+    int cols_ = 0, rows_ = 0;
+    std::vector<int> cell_begin_; // offsets of cells, cols_ * rows_ + 1
+    std::vector<visual::Feature::Ptr> features_;
+    std::vector<float> xs_, ys_, angles_;
+    std::vector<uint64_t> descriptors_; // 4 words per feature
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_GRID_H
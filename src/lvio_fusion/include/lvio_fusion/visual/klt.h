@@ -0,0 +1,38 @@
+#ifndef lvio_fusion_KLT_H
+#define lvio_fusion_KLT_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+// sparse KLT tracker, inverse compositional with translation only.
+// it works on the pyramids from build_optical_flow_pyramid()
+class KLT
+{
+public:
+    KLT(int half_window = 10, int max_level = 3, int max_iterations = 30, float epsilon = 0.01);
+
+    // choose the window and the levels for the predicted motion in pixels,
+    // without a prediction use the default, the same as optical_flow()
+    static KLT Adapt(double motion);
+
+    // track points from prev to next and check them by tracking back, the same as optical_flow()
+    void Track(const std::vector<cv::Mat> &prev_pyramid, const std::vector<cv::Mat> &next_pyramid,
+               const std::vector<cv::Point2f> &prev_pts, std::vector<cv::Point2f> &next_pts,
+               std::vector<uchar> &status) const;
+
+    // track points from prev to next, next_pts are the initial guesses
+    void TrackForward(const std::vector<cv::Mat> &prev_pyramid, const std::vector<cv::Mat> &next_pyramid,
+                      const std::vector<cv::Point2f> &prev_pts, std::vector<cv::Point2f> &next_pts,
+                      std::vector<uchar> &status) const;
+
+    const int half_window;
+    const int max_level;
+    const int max_iterations;
+    const float epsilon;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_KLT_H
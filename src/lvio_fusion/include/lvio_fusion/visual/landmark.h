@@ -13,11 +13,16 @@ class Landmark
 public:
     typedef std::shared_ptr<Landmark> Ptr;
 
+    Landmark()
+    {
+        id = ++current_landmark_id;
+    }
+
     Vector3d ToWorld();
 
     void Clear();
 
-    std::weak_ptr<Frame> FirstFrame();
+    const std::weak_ptr<Frame> &FirstFrame();
     std::weak_ptr<Frame> LastFrame();
 
     void AddObservation(Feature::Ptr feature);
@@ -31,12 +36,6 @@ public:
     double inv_depth;               // inverse depth in the first observation
     Features observations;          // only for left feature
     Feature::Ptr first_observation; // the first right observation
-
-private:
-    Landmark()
-    {
-        id = ++current_landmark_id;
-    }
 };
 
 typedef std::unordered_map<unsigned long, Landmark::Ptr> Landmarks;
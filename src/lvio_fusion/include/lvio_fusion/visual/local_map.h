@@ -5,21 +5,21 @@
 #include "lvio_fusion/frame.h"
 #include "lvio_fusion/visual/extractor.h"
 #include "lvio_fusion/visual/feature.h"
+#include "lvio_fusion/visual/grid.h"
 #include "lvio_fusion/visual/landmark.h"
+#include "lvio_fusion/visual/stereo.h"
 
 namespace lvio_fusion
 {
 
 typedef std::vector<visual::Feature::Ptr> Level;
 typedef std::vector<Level> Pyramid;
-
-extern cv::Mat img_track;
+typedef std::vector<FeatureGrid> Grids;
 
 class LocalMap
 {
 public:
     LocalMap(int num_features) : extractor_(num_features),
-                                 matcher_(cv::DescriptorMatcher::create("BruteForce-Hamming")),
                                  num_levels_(extractor_.num_levels)
     {
         double current_factor = 1;
@@ -40,7 +40,11 @@ public:
 
     PointRGBCloud GetLocalLandmarks();
 
-    void UpdateCache();
+    // poses and positions which are not given are read from the map
+    void UpdateCache(const std::unordered_map<double, SE3d> &poses = {},
+                     const std::unordered_map<unsigned long, Vector3d> &positions = {});
+
+    void SetStereoMatcher(StereoMatcher::Ptr stereo_matcher) { stereo_matcher_ = stereo_matcher; }
 
     std::unordered_map<unsigned long, Vector3d> position_cache;
     std::unordered_map<double, SE3d> pose_cache;
@@ -60,13 +64,14 @@ private:
     std::vector<double> GetCovisibilityKeyFrames(Frame::Ptr frame);
 
     void Search(std::vector<double> kfs, Frame::Ptr frame);
-    void Search(Pyramid &last_pyramid, SE3d last_pose, Pyramid &current_pyramid, Frame::Ptr frame);
-    void Search(Pyramid &last_pyramid, SE3d last_pose, visual::Feature::Ptr feature, Frame::Ptr frame);
+    void Search(const Grids &last_grids, SE3d last_pose, Pyramid &current_pyramid, Frame::Ptr frame);
+    void Search(const Grids &last_grids, SE3d last_pose, visual::Feature::Ptr feature, Frame::Ptr frame);
 
     std::mutex mutex_;
     Extractor extractor_;
-    cv::Ptr<cv::DescriptorMatcher> matcher_;
+    StereoMatcher::Ptr stereo_matcher_;
     std::map<double, Pyramid> local_features_;
+    std::map<double, Grids> local_grids_; // grids of local_features_ for searching
     std::vector<double> scale_factors_;
 
     const int num_levels_;
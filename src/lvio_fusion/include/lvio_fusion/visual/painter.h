@@ -0,0 +1,90 @@
+#ifndef lvio_fusion_PAINTER_H
+#define lvio_fusion_PAINTER_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+// collect draw records of tracking, and render them on a low priority thread.
+// a frame is dropped if the last one is not rendered yet.
+// nothing is recorded in headless mode.
+class Painter
+{
+public:
+    static Painter &Instance()
+    {
+        static Painter instance;
+        return instance;
+    }
+
+    ~Painter();
+
+    void Init(bool headless);
+
+    bool Enabled() const { return enabled_; }
+
+    // start a new frame on a grayscale image
+    void Begin(const cv::Mat &image)
+    {
+        if (enabled_)
+        {
+            current_.image = image;
+            current_.records.clear();
+        }
+    }
+
+    void Arrow(cv::Point2f from, cv::Point2f to, cv::Scalar color) { Add(Record::ARROW, from, to, color); }
+
+    void Circle(cv::Point2f pt, cv::Scalar color) { Add(Record::CIRCLE, pt, pt, color); }
+
+    void Cross(cv::Point2f pt, cv::Scalar color) { Add(Record::CROSS, pt, pt, color); }
+
+    // submit the frame to render
+    void End();
+
+private:
+    struct Record
+    {
+        enum Type
+        {
+            ARROW,
+            CIRCLE,
+            CROSS
+        } type;
+        cv::Point2f p0, p1;
+        cv::Scalar color;
+    };
+
+    struct Canvas
+    {
+        cv::Mat image;
+        std::vector<Record> records;
+    };
+
+    Painter() {}
+    Painter(const Painter &);
+    Painter &operator=(const Painter &);
+
+    void Add(Record::Type type, cv::Point2f p0, cv::Point2f p1, cv::Scalar color)
+    {
+        if (enabled_)
+        {
+            current_.records.push_back({type, p0, p1, color});
+        }
+    }
+
+    void RenderLoop();
+
+    bool enabled_ = false;
+    bool running_ = false;
+    bool pending_ = false;
+    Canvas current_, next_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_PAINTER_H
@@ -0,0 +1,44 @@
+#ifndef lvio_fusion_STEREO_H
+#define lvio_fusion_STEREO_H
+
+#include "lvio_fusion/common.h"
+
+namespace lvio_fusion
+{
+
+// match stereo points along the scanlines of rectified images,
+// depths are solved from disparities directly.
+class StereoMatcher
+{
+public:
+    typedef std::shared_ptr<StereoMatcher> Ptr;
+
+    StereoMatcher() {}
+
+    /**
+     * match points of the left image in the right image, images are undistorted
+     * @param image_left    left image
+     * @param image_right   right image
+     * @param kps_left      points in the left image
+     * @param kps_right     points in the right image
+     * @param pbs           points in the robot coordinate
+     * @param status        status
+     */
+    void Match(const cv::Mat &image_left, const cv::Mat &image_right,
+               const std::vector<cv::Point2f> &kps_left, std::vector<cv::Point2f> &kps_right,
+               std::vector<Vector3d> &pbs, std::vector<uchar> &status);
+
+private:
+    void Init(cv::Size size);
+
+    cv::Size size_;
+    cv::Mat map_left_[2], map_right_[2]; // rectification maps
+    cv::Mat R_left_, P_left_;            // rectification of the left camera
+    Matrix3d R_left_inverse_;
+    double f_ = 0, cx_ = 0, cy_ = 0, bf_ = 0;
+    int max_disparity_ = 0;
+};
+
+} // namespace lvio_fusion
+
+#endif // lvio_fusion_STEREO_H
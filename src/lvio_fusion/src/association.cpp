@@ -24,7 +24,7 @@ void FeatureAssociation::AddScan(double time, Point3Cloud::Ptr new_scan)
     static Frame::Ptr last_frame;
     raw_point_clouds_[time] = new_scan;
 
-    Frames new_kfs = Map::Instance().GetKeyFrames(finished, time);
+    FramesView new_kfs = Map::Instance().GetKeyFrames(finished, time);
     for (auto &pair : new_kfs)
     {
         PointICloud point_cloud;
@@ -269,7 +269,6 @@ inline void FeatureAssociation::SegmentGround(PointICloud &points_ground)
 
 void FeatureAssociation::ScanToMapWithGround(Frame::Ptr frame, Frame::Ptr map_frame, double *para, adapt::Problem &problem, bool relocate)
 {
-    ceres::LossFunction *loss_function = new ceres::TrivialLoss();
     PointICloud &points_ground_last = map_frame->feature_lidar->points_ground;
     problem.AddParameterBlock(para + 1, 1);
     problem.AddParameterBlock(para + 2, 1);
@@ -287,6 +286,8 @@ void FeatureAssociation::ScanToMapWithGround(Frame::Ptr frame, Frame::Ptr map_fr
     Sophus::SE3f tf_se3 = frame->pose.cast<float>();
     float *tf = tf_se3.data();
 
+    // all correspondences are in one residual block
+    auto lidar_error = new LidarPlaneBatchError(map_frame->pose, para, 1, 2, 5, 0);
     // find correspondence for ground features
     for (int i = 0; i < num_points_flat; ++i)
     {
@@ -312,12 +313,19 @@ void FeatureAssociation::ScanToMapWithGround(Frame::Ptr frame, Frame::Ptr map_fr
             Vector3d last_point_c(points_ground_last[points_index[2]].x,
                                   points_ground_last[points_index[2]].y,
                                   points_ground_last[points_index[2]].z);
-            ceres::CostFunction *cost_function;
-            cost_function = LidarPlaneErrorRPZ::Create(curr_point, last_point_a, last_point_b, last_point_c, map_frame->pose, para, frame->weights.lidar_ground);
-            problem.AddResidualBlock(ProblemType::LidarError, cost_function, loss_function, para + 1, para + 2, para + 5);
+            lidar_error->Add(curr_point, last_point_a, last_point_b, last_point_c, frame->weights.lidar_ground);
         }
     }
 
+    if (lidar_error->num_residuals())
+    {
+        problem.AddResidualBlock(ProblemType::LidarError, lidar_error, NULL, para + 1, para + 2, para + 5);
+    }
+    else
+    {
+        delete lidar_error;
+    }
+
     if (!relocate)
     {
         ceres::CostFunction *cost_function = PoseErrorRPZ::Create(para, frame->features_left.size() * frame->weights.visual);
@@ -327,7 +335,6 @@ void FeatureAssociation::ScanToMapWithGround(Frame::Ptr frame, Frame::Ptr map_fr
 
 void FeatureAssociation::ScanToMapWithSegmented(Frame::Ptr frame, Frame::Ptr map_frame, double *para, adapt::Problem &problem, bool relocate)
 {
-    ceres::LossFunction *loss_function = new ceres::HuberLoss(0.1);
     PointICloud &points_surf_last = map_frame->feature_lidar->points_surf;
     problem.AddParameterBlock(para + 0, 1);
     problem.AddParameterBlock(para + 3, 1);
@@ -345,6 +352,8 @@ void FeatureAssociation::ScanToMapWithSegmented(Frame::Ptr frame, Frame::Ptr map
     Sophus::SE3f tf_se3 = frame->pose.cast<float>();
     float *tf = tf_se3.data();
 
+    // all correspondences are in one residual block
+    auto lidar_error = new LidarPlaneBatchError(map_frame->pose, para, 0, 3, 4, 0.1);
     // find correspondence for plane features
     for (int i = 0; i < num_points_flat; ++i)
     {
@@ -370,12 +379,19 @@ void FeatureAssociation::ScanToMapWithSegmented(Frame::Ptr frame, Frame::Ptr map
             Vector3d last_point_c(points_surf_last[points_index[2]].x,
                                   points_surf_last[points_index[2]].y,
                                   points_surf_last[points_index[2]].z);
-            ceres::CostFunction *cost_function;
-            cost_function = LidarPlaneErrorYXY::Create(curr_point, last_point_a, last_point_b, last_point_c, map_frame->pose, para, frame->weights.lidar_surf);
-            problem.AddResidualBlock(ProblemType::LidarError, cost_function, loss_function, para, para + 3, para + 4);
+            lidar_error->Add(curr_point, last_point_a, last_point_b, last_point_c, frame->weights.lidar_surf);
         }
     }
 
+    if (lidar_error->num_residuals())
+    {
+        problem.AddResidualBlock(ProblemType::LidarError, lidar_error, NULL, para, para + 3, para + 4);
+    }
+    else
+    {
+        delete lidar_error;
+    }
+
     if (!relocate)
     {
         ceres::CostFunction *cost_function = PoseErrorYXY::Create(para, frame->features_left.size() * frame->weights.visual);
@@ -1,5 +1,6 @@
 #include "lvio_fusion/backend.h"
 #include "lvio_fusion/ceres/imu_error.hpp"
+#include "lvio_fusion/ceres/marginalization_error.hpp"
 #include "lvio_fusion/ceres/pose_error.hpp"
 #include "lvio_fusion/ceres/visual_error.hpp"
 #include "lvio_fusion/frontend.h"
@@ -13,8 +14,23 @@
 namespace lvio_fusion
 {
 
-Backend::Backend(double window_size, bool update_weights)
-    : window_size_(window_size), update_weights_(update_weights)
+// loss function and local parameterization are owned by the backend and shared by problems
+inline ceres::Problem::Options problem_options()
+{
+    ceres::Problem::Options options;
+    options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    options.local_parameterization_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+    options.enable_fast_removal = true;
+    return options;
+}
+
+Backend::Backend(double window_size, bool update_weights, bool marginalization)
+    : loss_function_(new ceres::HuberLoss(1.0)),
+      local_parameterization_(new ceres::ProductParameterization(
+          new ceres::EigenQuaternionParameterization(),
+          new ceres::IdentityParameterization(3))),
+      problem_(problem_options()),
+      window_size_(window_size), update_weights_(update_weights), marginalization_(marginalization)
 {
     thread_ = std::thread(std::bind(&Backend::BackendLoop, this));
     thread_global_ = std::thread(std::bind(&Backend::GlobalLoop, this));
@@ -81,99 +97,284 @@ void Backend::GlobalLoop()
     }
 }
 
-void Backend::BuildProblem(Frames &active_kfs, adapt::Problem &problem)
+// landmarks observed by the keyframe, and what decides the residual blocks:
+// the first frames of landmarks, positions of landmarks out of the window,
+// and whether landmarks are far from the keyframe, which makes their blocks weak.
+inline void get_observations(Frame::Ptr frame, double start_time,
+                             std::vector<std::pair<unsigned long, double>> &observations,
+                             std::vector<Vector3d> &points, std::vector<bool> &far)
 {
-    ceres::LossFunction *loss_function = new ceres::HuberLoss(1.0);
-    ceres::LocalParameterization *local_parameterization = new ceres::ProductParameterization(
-        new ceres::EigenQuaternionParameterization(),
-        new ceres::IdentityParameterization(3));
+    observations.clear();
+    points.clear();
+    far.clear();
+    for (auto &pair_feature : frame->features_left)
+    {
+        auto landmark = pair_feature.second->landmark.get();
+        auto first_frame = landmark->FirstFrame().lock();
+        Vector3d pw = landmark->ToWorld();
+        far.push_back(Camera::Get()->Far(pw, frame->pose));
+        if (first_frame->time < start_time)
+        {
+            observations.emplace_back(pair_feature.first, 0);
+            points.push_back(pw);
+        }
+        else
+        {
+            observations.emplace_back(pair_feature.first, first_frame->time);
+        }
+    }
+}
 
-    double start_time = active_kfs.begin()->first;
-    double global_end = start_time;
-    Frame::Ptr last_frame;
-    double *para_last_kf;
-    for (auto &pair_kf : active_kfs)
+inline bool has_imu_error(Frame::Ptr frame, Frame::Ptr last_frame)
+{
+    return Imu::Num() && Imu::Get()->initialized && frame->good_imu && last_frame && last_frame->good_imu;
+}
+
+void Backend::AddKeyframe(Frame::Ptr frame, Frame::Ptr last_frame, double start_time, adapt::Problem &problem, KeyframeResiduals &residuals,
+                          const std::unordered_set<unsigned long> *marginalized)
+{
+    ceres::LossFunction *loss_function = loss_function_.get();
+    residuals.frame = frame;
+    residuals.last_frame = last_frame;
+    residuals.imu = has_imu_error(frame, last_frame);
+    residuals.weak = false;
+    residuals.weight = frame->weights.visual;
+    residuals.observations.clear();
+    residuals.points.clear();
+    residuals.far.clear();
+    residuals.blocks.clear();
+    residuals.inv_depths.clear();
+    residuals.global_end = std::numeric_limits<double>::max();
+
+    int num_visual = 0;
+    double *para_kf = frame->pose.data();
+    problem.AddParameterBlock(para_kf, SE3d::num_parameters, local_parameterization_.get());
+    for (auto &pair_feature : frame->features_left)
     {
-        auto frame = pair_kf.second;
-        double *para_kf = frame->pose.data();
-        problem.AddParameterBlock(para_kf, SE3d::num_parameters, local_parameterization);
-        for (auto &pair_feature : frame->features_left)
+        auto feature = pair_feature.second;
+        auto landmark = feature->landmark.get();
+        auto first_frame = landmark->FirstFrame().lock();
+        Vector3d pw = landmark->ToWorld();
+        auto type = Camera::Get()->Far(pw, frame->pose) ? ProblemType::WeakError : ProblemType::VisualError;
+        ceres::CostFunction *cost_function;
+        residuals.far.push_back(type == ProblemType::WeakError);
+        residuals.observations.emplace_back(pair_feature.first, first_frame->time < start_time ? 0 : first_frame->time);
+        if (first_frame == frame)
         {
-            auto feature = pair_feature.second;
-            auto landmark = feature->landmark.lock();
-            auto first_frame = landmark->FirstFrame().lock();
-            auto type = Camera::Get()->Far(landmark->ToWorld(), frame->pose) ? ProblemType::WeakError : ProblemType::VisualError;
-            ceres::CostFunction *cost_function;
-            if (first_frame == frame)
-            {
-                double *para_inv_depth = &landmark->inv_depth;
-                problem.AddParameterBlock(para_inv_depth, 1);
-                cost_function = TwoCameraReprojectionError::Create(cv2eigen(feature->keypoint.pt), cv2eigen(landmark->first_observation->keypoint.pt), Camera::Get(0), Camera::Get(1), 5 * frame->weights.visual);
-                problem.AddResidualBlock(ProblemType::Other, cost_function, loss_function, para_inv_depth);
-            }
-            else if (first_frame->time < start_time)
+            double *para_inv_depth = &landmark->inv_depth;
+            problem.AddParameterBlock(para_inv_depth, 1);
+            cost_function = TwoCameraReprojectionError::Create(cv2eigen(feature->keypoint.pt), cv2eigen(landmark->first_observation->keypoint.pt), Camera::Get(0), Camera::Get(1), 5 * frame->weights.visual);
+            residuals.blocks.push_back(problem.AddResidualBlock(ProblemType::Other, cost_function, loss_function, para_inv_depth));
+            residuals.inv_depths.push_back(para_inv_depth);
+        }
+        else if (first_frame->time < start_time)
+        {
+            residuals.global_end = std::min(first_frame->last_keyframe ? first_frame->last_keyframe->time : 0, residuals.global_end);
+            residuals.points.push_back(pw);
+            num_visual += type == ProblemType::VisualError;
+            if (marginalized && marginalized->count(pair_feature.first))
+                continue;
+            cost_function = PoseOnlyReprojectionError::Create(cv2eigen(feature->keypoint.pt), pw, Camera::Get(), frame->weights.visual);
+            residuals.blocks.push_back(problem.AddResidualBlock(type, cost_function, loss_function, para_kf));
+        }
+        else
+        {
+            double *para_fist_kf = first_frame->pose.data();
+            double *para_inv_depth = &landmark->inv_depth;
+            problem.AddParameterBlock(para_inv_depth, 1);
+            // first ob is on right camera; current ob is on left camera;
+            cost_function = TwoFrameReprojectionError::Create(cv2eigen(landmark->first_observation->keypoint.pt), cv2eigen(feature->keypoint.pt), Camera::Get(0), Camera::Get(1), frame->weights.visual);
+            residuals.blocks.push_back(problem.AddResidualBlock(type, cost_function, loss_function, para_inv_depth, para_fist_kf, para_kf));
+            residuals.inv_depths.push_back(para_inv_depth);
+            num_visual += type == ProblemType::VisualError;
+        }
+    }
+
+    if (Imu::Num() && Imu::Get()->initialized)
+    {
+        if (frame->good_imu)
+        {
+            auto para_v = frame->Vw.data();
+            auto para_bg = frame->bias.linearized_bg.data();
+            auto para_ba = frame->bias.linearized_ba.data();
+            problem.AddParameterBlock(para_v, 3);
+            problem.AddParameterBlock(para_ba, 3);
+            problem.AddParameterBlock(para_bg, 3);
+            if (residuals.imu)
             {
-                global_end = std::min(first_frame->last_keyframe ? first_frame->last_keyframe->time : 0, global_end);
-                cost_function = PoseOnlyReprojectionError::Create(cv2eigen(feature->keypoint.pt), landmark->ToWorld(), Camera::Get(), frame->weights.visual);
-                problem.AddResidualBlock(type, cost_function, loss_function, para_kf);
+                auto para_last_kf = last_frame->pose.data();
+                auto para_v_last = last_frame->Vw.data();
+                auto para_bg_last = last_frame->bias.linearized_bg.data();
+                auto para_ba_last = last_frame->bias.linearized_ba.data();
+                ceres::CostFunction *cost_function = ImuError::Create(frame->preintegration);
+                residuals.blocks.push_back(problem.AddResidualBlock(ProblemType::ImuError, cost_function, NULL, para_last_kf, para_v_last, para_ba_last, para_bg_last, para_kf, para_v, para_ba, para_bg));
             }
-            else
+        }
+    }
+
+    // vehicle constraints
+    // if (last_frame)
+    // {
+    //     ceres::CostFunction *cost_function = VehicleError::Create(frame->time - last_frame->time, 1e4);
+    //     problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, para_last_kf, para_kf);
+    // }
+
+    // check if weak constraint, blocks of later keyframes are not counted
+    if (!residuals.imu && num_visual < 10)
+    {
+        residuals.weak = true;
+        if (last_frame)
+        {
+            ceres::CostFunction *cost_function = PoseGraphError::Create(last_frame->pose, frame->pose, 100);
+            residuals.blocks.push_back(problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, last_frame->pose.data(), para_kf));
+        }
+        else
+        {
+            ceres::CostFunction *cost_function = PoseError::Create(frame->pose, 100);
+            residuals.blocks.push_back(problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, para_kf));
+        }
+    }
+}
+
+void Backend::RemoveKeyframe(KeyframeResiduals &residuals)
+{
+    for (auto id : residuals.blocks)
+    {
+        problem_.RemoveResidualBlock(id);
+    }
+    for (auto para_inv_depth : residuals.inv_depths)
+    {
+        if (--inv_depths_[para_inv_depth] == 0)
+        {
+            inv_depths_.erase(para_inv_depth);
+            problem_.RemoveParameterBlock(para_inv_depth);
+        }
+    }
+}
+
+void Backend::Marginalize(const FramesView &active_kfs)
+{
+    double start_time = active_kfs.begin()->first;
+    std::unordered_set<double *> marginalized;
+    for (auto &pair : residuals_)
+    {
+        if (active_kfs.count(pair.first))
+            continue;
+        // states of the keyframe, and landmarks first observed in it or in older keyframes
+        auto frame = pair.second.frame;
+        for (double *para : {frame->pose.data(), frame->Vw.data(), frame->bias.linearized_ba.data(), frame->bias.linearized_bg.data()})
+        {
+            if (problem_.HasParameterBlock(para))
             {
-                double *para_fist_kf = first_frame->pose.data();
-                double *para_inv_depth = &landmark->inv_depth;
-                problem.AddParameterBlock(para_inv_depth, 1);
-                // first ob is on right camera; current ob is on left camera;
-                cost_function = TwoFrameReprojectionError::Create(cv2eigen(landmark->first_observation->keypoint.pt), cv2eigen(feature->keypoint.pt), Camera::Get(0), Camera::Get(1), frame->weights.visual);
-                problem.AddResidualBlock(type, cost_function, loss_function, para_inv_depth, para_fist_kf, para_kf);
+                marginalized.insert(para);
             }
         }
+        marginalized.insert(pair.second.inv_depths.begin(), pair.second.inv_depths.end());
+    }
+    if (marginalized.empty())
+        return;
+
+    MarginalizationError *prior = MarginalizationError::Create(problem_, marginalized, prior_id_);
+    if (prior_id_)
+    {
+        problem_.RemoveResidualBlock(prior_id_);
+        prior_ = nullptr;
+        prior_id_ = nullptr;
+    }
+    if (prior)
+    {
+        prior_ = prior;
+        prior_id_ = problem_.AddResidualBlock(ProblemType::Other, prior, NULL, prior->ParameterBlocks());
+    }
 
-        if (Imu::Num() && Imu::Get()->initialized)
+    // observations of marginalized landmarks are in the prior now
+    for (auto &pair : residuals_)
+    {
+        if (!active_kfs.count(pair.first))
+            continue;
+        for (auto &observation : pair.second.observations)
         {
-            if (frame->good_imu)
+            if (observation.second != 0 && observation.second < start_time)
             {
-                auto para_v = frame->Vw.data();
-                auto para_bg = frame->bias.linearized_bg.data();
-                auto para_ba = frame->bias.linearized_ba.data();
-                problem.AddParameterBlock(para_v, 3);
-                problem.AddParameterBlock(para_ba, 3);
-                problem.AddParameterBlock(para_bg, 3);
-                if (last_frame && last_frame->good_imu)
-                {
-                    auto para_v_last = last_frame->Vw.data();
-                    auto para_bg_last = last_frame->bias.linearized_bg.data();
-                    auto para_ba_last = last_frame->bias.linearized_ba.data();
-                    ceres::CostFunction *cost_function = ImuError::Create(frame->preintegration);
-                    problem.AddResidualBlock(ProblemType::ImuError, cost_function, NULL, para_last_kf, para_v_last, para_ba_last, para_bg_last, para_kf, para_v, para_ba, para_bg);
-                }
+                marginalized_[pair.first].insert(observation.first);
             }
         }
+    }
+}
 
-        // vehicle constraints
-        // if (last_frame)
-        // {
-        //     ceres::CostFunction *cost_function = VehicleError::Create(frame->time - last_frame->time, 1e4);
-        //     problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, para_last_kf, para_kf);
-        // }
-
-        // check if weak constraint
-        auto num_types = problem.GetTypes(para_kf);
-        if (!num_types[ProblemType::ImuError] && num_types[ProblemType::VisualError] < 10)
+void Backend::UpdateProblem(const FramesView &active_kfs)
+{
+    double start_time = active_kfs.begin()->first;
+    std::vector<std::pair<unsigned long, double>> observations;
+    std::vector<Vector3d> points;
+    std::vector<bool> far;
+    std::vector<Frame::Ptr> old_frames;
+    if (prior_)
+    {
+        prior_->Follow();
+    }
+    if (marginalization_)
+    {
+        Marginalize(active_kfs);
+    }
+    // remove keyframes which left the window, and keyframes whose blocks are out of date,
+    // e.g. the first frames of landmarks left the window, outliers are rejected or poses are corrected.
+    for (auto iter = residuals_.begin(); iter != residuals_.end();)
+    {
+        auto &residuals = iter->second;
+        auto pair_kf = active_kfs.find(iter->first);
+        if (pair_kf != active_kfs.end())
         {
-            if (last_frame)
+            auto frame = pair_kf->second;
+            auto last_frame = pair_kf == active_kfs.begin() ? Frame::Ptr() : std::prev(pair_kf)->second;
+            get_observations(frame, start_time, observations, points, far);
+            if (!residuals.weak && residuals.frame == frame && residuals.last_frame == last_frame &&
+                residuals.imu == has_imu_error(frame, last_frame) && residuals.weight == frame->weights.visual &&
+                residuals.observations == observations && residuals.points == points && residuals.far == far)
             {
-                ceres::CostFunction *cost_function = PoseGraphError::Create(last_frame->pose, frame->pose, 100);
-                problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, para_last_kf, para_kf);
+                iter++;
+                continue;
             }
-            else
+        }
+        else
+        {
+            old_frames.push_back(residuals.frame);
+            marginalized_.erase(iter->first);
+        }
+        RemoveKeyframe(residuals);
+        iter = residuals_.erase(iter);
+    }
+    // no residual block uses old keyframes now
+    for (auto &frame : old_frames)
+    {
+        for (double *para : {frame->pose.data(), frame->Vw.data(), frame->bias.linearized_ba.data(), frame->bias.linearized_bg.data()})
+        {
+            if (problem_.HasParameterBlock(para))
             {
-                ceres::CostFunction *cost_function = PoseError::Create(frame->pose, 100);
-                problem.AddResidualBlock(ProblemType::Other, cost_function, NULL, para_kf);
+                problem_.RemoveParameterBlock(para);
             }
         }
+    }
 
-        last_frame = frame;
-        para_last_kf = para_kf;
+    // add new keyframes, and keyframes to rebuild
+    double global_end = start_time;
+    Frame::Ptr last_frame;
+    for (auto &pair_kf : active_kfs)
+    {
+        auto iter = residuals_.find(pair_kf.first);
+        if (iter == residuals_.end())
+        {
+            auto marginalized = marginalized_.find(pair_kf.first);
+            iter = residuals_.emplace(pair_kf.first, KeyframeResiduals()).first;
+            AddKeyframe(pair_kf.second, last_frame, start_time, problem_, iter->second,
+                        marginalized == marginalized_.end() ? nullptr : &marginalized->second);
+            for (auto para_inv_depth : iter->second.inv_depths)
+            {
+                inv_depths_[para_inv_depth]++;
+            }
+        }
+        global_end = std::min(iter->second.global_end, global_end);
+        last_frame = pair_kf.second;
     }
     global_end_ = global_end;
 }
@@ -187,7 +388,13 @@ double compute_reprojection_error(Vector2d ob, Vector3d pw, SE3d pose, Camera::P
 
 void Backend::Optimize()
 {
-    Frames active_kfs = Map::Instance().GetKeyFrames(finished);
+    // keyframes are not modified until the frontend has applied the last state
+    {
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        state_applied_.wait(lock, [this] { return applied_version_ >= version_; });
+    }
+
+    FramesView active_kfs = Map::Instance().GetKeyFrames(finished);
     if (active_kfs.empty())
         return;
 
@@ -196,29 +403,32 @@ void Backend::Optimize()
     SE3d old_pose = (--active_kfs.end())->second->pose;
     SE3d start_pose = active_kfs.begin()->second->pose;
 
-    adapt::Problem problem;
-    BuildProblem(active_kfs, problem);
+    UpdateProblem(active_kfs);
 
     ceres::Solver::Options options;
     options.linear_solver_type = ceres::SPARSE_SCHUR;
     options.max_solver_time_in_seconds = (end - start) / active_kfs.size();
     options.num_threads = num_threads;
     ceres::Solver::Summary summary;
-    adapt::Solve(options, &problem, &summary);
+    adapt::Solve(options, &problem_, &summary);
+    if (prior_)
+    {
+        prior_->Snapshot();
+    }
     if (Imu::Num() && Imu::Get()->initialized)
     {
         imu::RecoverBias(active_kfs);
     }
 
-    // update frontend
+    // publish to frontend
     SE3d new_pose = (--active_kfs.end())->second->pose;
     SE3d transform = new_pose * old_pose.inverse();
-    UpdateFrontend(transform, end + epsilon);
+    PublishState(active_kfs, transform, end + epsilon);
     finished = end + epsilon - window_size_;
 
     if (Lidar::Num() && mapping_)
     {
-        Frames mapping_kfs = Map::Instance().GetKeyFrames(start, end - window_size_);
+        FramesView mapping_kfs = Map::Instance().GetKeyFrames(start, end - window_size_);
         mapping_->Optimize(mapping_kfs);
     }
 
@@ -230,7 +440,7 @@ void Backend::Optimize()
         for (auto &pair_feature : features_left)
         {
             auto feature = pair_feature.second;
-            auto landmark = feature->landmark.lock();
+            auto landmark = feature->landmark.get();
             auto first_frame = landmark->FirstFrame().lock();
             if (frame != first_frame && compute_reprojection_error(cv2eigen(feature->keypoint.pt), landmark->ToWorld(), frame->pose, Camera::Get()) > 10)
             {
@@ -241,54 +451,72 @@ void Backend::Optimize()
     }
 }
 
-void Backend::UpdateFrontend(SE3d transform, double time)
+void Backend::PublishState(const FramesView &active_kfs, SE3d transform, double time)
 {
-    // perpare for active kfs
-    std::unique_lock<std::mutex> lock(frontend_.lock()->mutex);
-    Frame::Ptr last_frame = frontend_.lock()->last_frame;
-    Frames active_kfs = Map::Instance().GetKeyFrames(time);
-    if (active_kfs.find(last_frame->time) == active_kfs.end())
+    double init_time;
     {
-        active_kfs[last_frame->time] = last_frame;
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        init_time = init_time_;
     }
-    PoseGraph::Instance().ForwardUpdate(transform, active_kfs);
 
-    adapt::Problem problem;
-    BuildProblem(active_kfs, problem);
-
-    ceres::Solver::Options options;
-    options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
-    options.max_num_iterations = 1;
-    options.num_threads = num_threads;
-    ceres::Solver::Summary summary;
-    adapt::Solve(options, &problem, &summary);
-    if (Imu::Num() && Imu::Get()->initialized)
+    // imu initialization, Imu::initialized is set when the frontend applies the state
+    bool initialized = Imu::Num() && Imu::Get()->initialized;
+    SE3d transform_init;
+    if (Imu::Num() && (!Navsat::Num() || (Navsat::Num() && Navsat::Get()->initialized)) &&
+        initializer_->Initialize(init_time, time, initialized, transform_init))
     {
-        imu::RecoverBias(active_kfs);
+        transform = transform_init * transform;
     }
 
-    // imu initialization
-    if (Imu::Num() && (!Navsat::Num() || (Navsat::Num() && Navsat::Get()->initialized)))
-    {
-        initializer_->Initialize(frontend_.lock()->init_time, time);
-    }
-    // update imu
-    if (Imu::Num() && Imu::Get()->initialized)
+    back_state_.time = time;
+    back_state_.transform = transform;
+    back_state_.init_time = init_time;
+    back_state_.initialized = initialized;
+    back_state_.poses.clear();
+    back_state_.positions.clear();
+    for (auto &pair_kf : active_kfs)
     {
-        Frame::Ptr prior_frame = Map::Instance().GetKeyFrames(0, time, 1).begin()->second;
-        imu::RePredictVel(active_kfs, prior_frame);
-        if (active_kfs.size() == 0)
-        {
-            frontend_.lock()->UpdateImu(prior_frame->bias);
-        }
-        else
+        back_state_.poses[pair_kf.first] = pair_kf.second->pose;
+        for (auto &pair_feature : pair_kf.second->features_left)
         {
-            frontend_.lock()->UpdateImu((--active_kfs.end())->second->bias);
+            auto landmark = pair_feature.second->landmark.get();
+            if (landmark && landmark->FirstFrame().lock() == pair_kf.second)
+            {
+                back_state_.positions[landmark->id] = landmark->ToWorld();
+            }
         }
     }
+    back_state_.prior_frame = nullptr;
+    if (initialized)
+    {
+        Frame::Ptr frame = Map::Instance().GetKeyFrames(0, time, 1).begin()->second;
+        back_state_.prior_frame = Frame::Ptr(new Frame);
+        back_state_.prior_frame->time = frame->time;
+        back_state_.prior_frame->pose = frame->pose;
+        back_state_.prior_frame->Vw = frame->Vw;
+        back_state_.prior_frame->bias = frame->bias;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    back_state_.version = ++version_;
+    std::swap(front_state_, back_state_);
+}
 
-    // update frontend landmarks and pose
-    frontend_.lock()->UpdateCache();
+bool Backend::TakeState(BackendState &state, double init_time)
+{
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    init_time_ = init_time;
+    if (front_state_.version <= state.version)
+        return false;
+    std::swap(front_state_, state);
+    return true;
+}
+
+void Backend::StateApplied(unsigned long version)
+{
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    applied_version_ = version;
+    state_applied_.notify_all();
 }
 
 } // namespace lvio_fusion
\ No newline at end of file
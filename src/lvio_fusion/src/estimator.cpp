@@ -2,6 +2,7 @@
 #include "lvio_fusion/config.h"
 #include "lvio_fusion/frame.h"
 #include "lvio_fusion/manager.h"
+#include "lvio_fusion/visual/painter.h"
 
 #include <opencv2/core/eigen.hpp>
 #include <sys/sysinfo.h>
@@ -12,8 +13,19 @@ const int num_threads = std::min(8, std::max(1, (int)(0.75 * get_nprocs())));
 namespace lvio_fusion
 {
 
+bool use_analytic_jacobian = false;
+
 Estimator::Estimator(std::string &config_path) : config_file_path_(config_path) {}
 
+Estimator::~Estimator()
+{
+    frames_.Close();
+    if (thread_frontend_.joinable())
+    {
+        thread_frontend_.join();
+    }
+}
+
 bool Estimator::Init(int use_imu, int use_lidar, int use_navsat, int use_loop, int use_adapt)
 {
     LOG(INFO) << "System info:\n\tepsilon: " << epsilon << "\n\tnum_threads: " << num_threads;
@@ -83,6 +95,9 @@ bool Estimator::Init(int use_imu, int use_lidar, int use_navsat, int use_loop, i
     }
     Camera::baseline = (t_body_to_cam0 - t_body_to_cam1).norm();
 
+    Painter::Instance().Init(Config::Get<int>("headless"));
+    use_analytic_jacobian = Config::Get<int>("analytic_jacobian");
+
     // create components and links
     frontend = Frontend::Ptr(new Frontend(
         Config::Get<int>("num_features"),
@@ -90,10 +105,15 @@ bool Estimator::Init(int use_imu, int use_lidar, int use_navsat, int use_loop, i
         Config::Get<int>("num_features_tracking"),
         Config::Get<int>("num_features_tracking_bad"),
         Config::Get<int>("num_features_needed_for_keyframe")));
+    if (Config::Get<int>("stereo_match"))
+    {
+        frontend->local_map.SetStereoMatcher(StereoMatcher::Ptr(new StereoMatcher));
+    }
 
     backend = Backend::Ptr(new Backend(
         Config::Get<double>("windows_size"),
-        use_adapt));
+        use_adapt,
+        Config::Get<int>("marginalization")));
 
     frontend->SetBackend(backend);
     backend->SetFrontend(frontend);
@@ -160,6 +180,8 @@ bool Estimator::Init(int use_imu, int use_lidar, int use_navsat, int use_loop, i
             relocator->SetMapping(mapping);
         }
     }
+
+    thread_frontend_ = std::thread(std::bind(&Estimator::FrontendLoop, this));
     return true;
 }
 
@@ -168,19 +190,44 @@ std::map<FrontendStatus, std::string> map_status = {
     {FrontendStatus::INITIALIZING, "Initializing"},
     {FrontendStatus::TRACKING, "Tracking"},
     {FrontendStatus::LOST, "Lost"}};
+void Estimator::Preprocess(Frame::Ptr frame, cv::Mat &left_image, cv::Mat &right_image)
+{
+    // equalize in place, then remap once into the frame
+    cv::equalizeHist(left_image, left_image);
+    Camera::Get(0)->Undistort(left_image, frame->image_left);
+    // the left pyramid is always used by tracking
+    frame->GetPyramidLeft();
+    // the right image is only processed if the frame becomes a keyframe
+    frame->SetImageRight(right_image);
+}
+
 void Estimator::InputImage(double time, cv::Mat &left_image, cv::Mat &right_image, SE3d init_odom)
 {
     Frame::Ptr new_frame = Frame::Create();
     new_frame->time = time;
     new_frame->pose = init_odom;
-    cv::undistort(left_image, new_frame->image_left, Camera::Get(0)->K, Camera::Get(0)->D);
-    cv::undistort(right_image, new_frame->image_right, Camera::Get(1)->K, Camera::Get(1)->D);
+    frontend->ExpectFrame(time);
 
     auto t1 = std::chrono::steady_clock::now();
-    bool success = frontend->AddFrame(new_frame);
+    Preprocess(new_frame, left_image, right_image);
     auto t2 = std::chrono::steady_clock::now();
     auto time_used = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-    LOG(INFO) << "Frontend status:" << map_status[frontend->status] << ", cost time: " << time_used.count() << " seconds.";
+    LOG(INFO) << "Preprocessing cost time: " << time_used.count() << " seconds.";
+    // wait if the frontend falls behind
+    frames_.Push(new_frame);
+}
+
+void Estimator::FrontendLoop()
+{
+    Frame::Ptr frame;
+    while (frames_.Pop(frame))
+    {
+        auto t1 = std::chrono::steady_clock::now();
+        bool success = frontend->AddFrame(frame);
+        auto t2 = std::chrono::steady_clock::now();
+        auto time_used = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+        LOG(INFO) << "Frontend status:" << map_status[frontend->status] << ", cost time: " << time_used.count() << " seconds.";
+    }
 }
 
 void Estimator::InputPointCloud(double time, Point3Cloud::Ptr point_cloud)
@@ -198,6 +245,11 @@ void Estimator::InputImu(double time, Vector3d acc, Vector3d gyr)
     frontend->AddImu(time, acc, gyr);
 }
 
+void Estimator::InputImu(const std::vector<ImuData> &data)
+{
+    frontend->AddImu(data);
+}
+
 void Estimator::InputNavSat(double time, double x, double y, double z, Vector3d cov)
 {
     Navsat::Get()->AddPoint(time, x, y, z, cov);
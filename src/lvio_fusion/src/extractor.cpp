@@ -1,4 +1,9 @@
 #include "lvio_fusion/visual/extractor.h"
+#include "lvio_fusion/utility.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace cv;
 using namespace std;
@@ -6,6 +11,275 @@ using namespace std;
 namespace lvio_fusion
 {
 
+// 256 point pairs of rBRIEF
+const int num_pattern_points = 512;
+
+// learned pattern of rBRIEF for 31x31 patches, 256 pairs of points [x0, y0, x1, y1].
+// from OpenCV (modules/features2d/src/orb.cpp), under the BSD license:
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the copyright notice, the conditions and the disclaimer
+// of the license are retained. the software is provided "as is", without any warranty.
+static const int bit_pattern_31[256 * 4] = {
+    8, -3, 9, 5,
+    4, 2, 7, -12,
+    -11, 9, -8, 2,
+    7, -12, 12, -13,
+    2, -13, 2, 12,
+    1, -7, 1, 6,
+    -2, -10, -2, -4,
+    -13, -13, -11, -8,
+    -13, -3, -12, -9,
+    10, 4, 11, 9,
+    -13, -8, -8, -9,
+    -11, 7, -9, 12,
+    7, 7, 12, 6,
+    -4, -5, -3, 0,
+    -13, 2, -12, -3,
+    -9, 0, -7, 5,
+    12, -6, 12, -1,
+    -3, 6, -2, 12,
+    -6, -13, -4, -8,
+    11, -13, 12, -8,
+    4, 7, 5, 1,
+    5, -3, 10, -3,
+    3, -7, 6, 12,
+    -8, -7, -6, -2,
+    -2, 11, -1, -10,
+    -13, 12, -8, 10,
+    -7, 3, -5, -3,
+    -4, 2, -3, 7,
+    -10, -12, -6, 11,
+    5, -12, 6, -7,
+    5, -6, 7, -1,
+    1, 0, 4, -5,
+    9, 11, 11, -13,
+    4, 7, 4, 12,
+    2, -1, 4, 4,
+    -4, -12, -2, 7,
+    -8, -5, -7, -10,
+    4, 11, 9, 12,
+    0, -8, 1, -13,
+    -13, -2, -8, 2,
+    -3, -2, -2, 3,
+    -6, 9, -4, -9,
+    8, 12, 10, 7,
+    0, 9, 1, 3,
+    7, -5, 11, -10,
+    -13, -6, -11, 0,
+    10, 7, 12, 1,
+    -6, -3, -6, 12,
+    10, -9, 12, -4,
+    -13, 8, -8, -12,
+    -13, 0, -8, -4,
+    3, 3, 7, 8,
+    5, 7, 10, -7,
+    -1, 7, 1, -12,
+    3, -10, 5, 6,
+    2, -4, 3, -10,
+    -13, 0, -13, 5,
+    -13, -7, -12, 12,
+    -13, 3, -11, 8,
+    -7, 12, -4, 7,
+    6, -10, 12, 8,
+    -9, -1, -7, -6,
+    -2, -5, 0, 12,
+    -12, 5, -7, 5,
+    3, -10, 8, -13,
+    -7, -7, -4, 5,
+    -3, -2, -1, -7,
+    2, 9, 5, -11,
+    -11, -13, -5, -13,
+    -1, 6, 0, -1,
+    5, -3, 5, 2,
+    -4, -13, -4, 12,
+    -9, -6, -9, 6,
+    -12, -10, -8, -4,
+    10, 2, 12, -3,
+    7, 12, 12, 12,
+    -7, -13, -6, 5,
+    -4, 9, -3, 4,
+    7, -1, 12, 2,
+    -7, 6, -5, 1,
+    -13, 11, -12, 5,
+    -3, 7, -2, -6,
+    7, -8, 12, -7,
+    -13, -7, -11, -12,
+    1, -3, 12, 12,
+    2, -6, 3, 0,
+    -4, 3, -2, -13,
+    -1, -13, 1, 9,
+    7, 1, 8, -6,
+    1, -1, 3, 12,
+    9, 1, 12, 6,
+    -1, -9, -1, 3,
+    -13, -13, -10, 5,
+    7, 7, 10, 12,
+    12, -5, 12, 9,
+    6, 3, 7, 11,
+    5, -13, 6, 10,
+    2, -12, 2, 3,
+    3, 8, 4, -6,
+    2, 6, 12, -13,
+    9, -12, 10, 3,
+    -8, 4, -7, 9,
+    -11, 12, -4, -6,
+    1, 12, 2, -8,
+    6, -9, 7, -4,
+    2, 3, 3, -2,
+    6, 3, 11, 0,
+    3, -3, 8, -8,
+    7, 8, 9, 3,
+    -11, -5, -6, -4,
+    -10, 11, -5, 10,
+    -5, -8, -3, 12,
+    -10, 5, -9, 0,
+    8, -1, 12, -6,
+    4, -6, 6, -11,
+    -10, 12, -8, 7,
+    4, -2, 6, 7,
+    -2, 0, -2, 12,
+    -5, -8, -5, 2,
+    7, -6, 10, 12,
+    -9, -13, -8, -8,
+    -5, -13, -5, -2,
+    8, -8, 9, -13,
+    -9, -11, -9, 0,
+    1, -8, 1, -2,
+    7, -4, 9, 1,
+    -2, 1, -1, -4,
+    11, -6, 12, -11,
+    -12, -9, -6, 4,
+    3, 7, 7, 12,
+    5, 5, 10, 8,
+    0, -4, 2, 8,
+    -9, 12, -5, -13,
+    0, 7, 2, 12,
+    -1, 2, 1, 7,
+    5, 11, 7, -9,
+    3, 5, 6, -8,
+    -13, -4, -8, 9,
+    -5, 9, -3, -3,
+    -4, -7, -3, -12,
+    6, 5, 8, 0,
+    -7, 6, -6, 12,
+    -13, 6, -5, -2,
+    1, -10, 3, 10,
+    4, 1, 8, -4,
+    -2, -2, 2, -13,
+    2, -12, 12, 12,
+    -2, -13, 0, -6,
+    4, 1, 9, 3,
+    -6, -10, -3, -5,
+    -3, -13, -1, 1,
+    7, 5, 12, -11,
+    4, -2, 5, -7,
+    -13, 9, -9, -5,
+    7, 1, 8, 6,
+    7, -8, 7, 6,
+    -7, -4, -7, 1,
+    -8, 11, -7, -8,
+    -13, 6, -12, -8,
+    2, 4, 3, 9,
+    10, -5, 12, 3,
+    -6, -5, -6, 7,
+    8, -3, 9, -8,
+    2, -12, 2, 8,
+    -11, -2, -10, 3,
+    -12, -13, -7, -9,
+    -11, 0, -10, -5,
+    5, -3, 11, 8,
+    -2, -13, -1, 12,
+    -1, -8, 0, 9,
+    -13, -11, -12, -5,
+    -10, -2, -10, 11,
+    -3, 9, -2, -13,
+    2, -3, 3, 2,
+    -9, -13, -4, 0,
+    -4, 6, -3, -10,
+    -4, 12, -2, -7,
+    -6, -11, -4, 9,
+    6, -3, 6, 11,
+    -13, 11, -5, 5,
+    11, 11, 12, 6,
+    7, -5, 12, -2,
+    -1, 12, 0, 7,
+    -4, -8, -3, -2,
+    -7, 1, -6, 7,
+    -13, -12, -8, -13,
+    -7, -2, -6, -8,
+    -8, 5, -6, -9,
+    -5, -1, -4, 5,
+    -13, 7, -8, 10,
+    1, 5, 5, -13,
+    1, 0, 10, -13,
+    9, 12, 10, -1,
+    5, -8, 10, -9,
+    -1, 11, 1, -13,
+    -9, -3, -6, 2,
+    -1, -10, 1, 12,
+    -13, 1, -8, -10,
+    8, -11, 10, -6,
+    2, -13, 3, -6,
+    7, -13, 12, -9,
+    -10, -10, -5, -7,
+    -10, -8, -8, -13,
+    4, -6, 8, 5,
+    3, 12, 8, -13,
+    -4, 2, -3, -3,
+    5, -13, 10, -12,
+    4, -13, 5, -1,
+    -9, 9, -4, 3,
+    0, 3, 3, -9,
+    -12, 1, -6, 1,
+    3, 2, 4, -8,
+    -10, -10, -10, 9,
+    8, -13, 12, 12,
+    -8, -12, -6, -5,
+    2, 2, 3, 7,
+    10, 6, 11, -8,
+    6, 8, 8, -12,
+    -7, 10, -6, 5,
+    -3, -9, -3, 9,
+    -1, -13, -1, 5,
+    -3, -7, -3, 4,
+    -8, -2, -8, 3,
+    4, 2, 12, 12,
+    2, -5, 3, 11,
+    6, -9, 11, -13,
+    3, -1, 7, 12,
+    11, -1, 12, 4,
+    -3, 0, -3, 6,
+    4, -11, 4, 12,
+    2, -4, 2, 1,
+    -10, -6, -8, 1,
+    -13, 7, -11, 1,
+    -13, 12, -11, -13,
+    6, 0, 11, -13,
+    0, -1, 1, 4,
+    -13, 3, -9, -2,
+    -9, 8, -6, -3,
+    -13, -6, -8, -2,
+    5, -9, 8, 10,
+    2, 7, 3, -9,
+    -1, -6, -1, -1,
+    9, 5, 11, -2,
+    11, -3, 12, -8,
+    3, 0, 3, 5,
+    -1, 4, 0, 10,
+    3, -6, 4, 5,
+    -13, 0, -10, 5,
+    5, 8, 12, 11,
+    8, 9, 9, -6,
+    7, -4, 8, -12,
+    -10, 4, -10, 9,
+    7, 3, 12, 4,
+    9, -7, 10, -2,
+    7, 0, 12, -2,
+    -1, -6, 0, -11,
+};
+
 Extractor::Extractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAST, int minThFAST, int patchSize, int edgeThreshold)
     : num_features(nfeatures), scale_factor(scaleFactor), num_levels(nlevels),
       init_FAST_thershold(iniThFAST), min_FAST_thershold(minThFAST),
@@ -29,7 +303,6 @@ Extractor::Extractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAS
         inv_sigma2_per_levels_[i] = 1.0f / sigma2_per_levels_[i];
     }
 
-    image_pyramid_.resize(num_levels);
 
     num_desired_features_.resize(num_levels);
     float inv_factor = 1.0f / scale_factor;
@@ -61,26 +334,81 @@ Extractor::Extractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAS
         umax_[v] = v0;
         ++v0;
     }
+
+    // point pairs for rBRIEF, the learned pattern for 31x31 patches,
+    // otherwise the random pattern as cv::ORB with a fixed seed
+    pattern_x_.resize(num_pattern_points);
+    pattern_y_.resize(num_pattern_points);
+    RNG rng(0x34985739);
+    for (int i = 0; i < num_pattern_points; i++)
+    {
+        if (patch_size == 31)
+        {
+            pattern_x_[i] = bit_pattern_31[2 * i];
+            pattern_y_[i] = bit_pattern_31[2 * i + 1];
+        }
+        else
+        {
+            pattern_x_[i] = rng.uniform(-half_patch_size, half_patch_size + 1);
+            pattern_y_[i] = rng.uniform(-half_patch_size, half_patch_size + 1);
+        }
+    }
 }
 
+#if defined(__SSE2__)
+inline int sum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+#endif
+
 inline float Extractor::ICAngle(const Mat &image, Point2f pt)
 {
     int m_01 = 0, m_10 = 0;
 
     const uchar *center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+    int step = (int)image.step1();
+    int u = -half_patch_size;
+
+#if defined(__SSE2__)
+    // 8 pixels a time, the sums are exact in 16/32 bits integers
+    const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+    const __m128i offsets = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    __m128i sum_10 = zero;
+    for (; u + 7 <= half_patch_size; u += 8)
+    {
+        __m128i val = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(center + u)), zero);
+        __m128i us = _mm_add_epi16(_mm_set1_epi16(u), offsets);
+        sum_10 = _mm_add_epi32(sum_10, _mm_madd_epi16(us, val));
+    }
+#endif
 
     // Treat the center line differently, v=0
-    for (int u = -half_patch_size; u <= half_patch_size; ++u)
+    for (; u <= half_patch_size; ++u)
         m_10 += u * center[u];
 
     // Go line by line in the circular patch
-    int step = (int)image.step1();
     for (int v = 1; v <= half_patch_size; ++v)
     {
         // Proceed over the two lines
         int v_sum = 0;
         int d = umax_[v];
-        for (int u = -d; u <= d; ++u)
+        u = -d;
+#if defined(__SSE2__)
+        __m128i sum_01 = zero;
+        for (; u + 7 <= d; u += 8)
+        {
+            __m128i val_plus = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(center + u + v * step)), zero);
+            __m128i val_minus = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(center + u - v * step)), zero);
+            __m128i us = _mm_add_epi16(_mm_set1_epi16(u), offsets);
+            sum_10 = _mm_add_epi32(sum_10, _mm_madd_epi16(us, _mm_add_epi16(val_plus, val_minus)));
+            sum_01 = _mm_add_epi32(sum_01, _mm_madd_epi16(ones, _mm_sub_epi16(val_plus, val_minus)));
+        }
+        v_sum += sum_epi32(sum_01);
+#endif
+        for (; u <= d; ++u)
         {
             int val_plus = center[u + v * step], val_minus = center[u - v * step];
             v_sum += (val_plus - val_minus);
@@ -88,6 +416,9 @@ inline float Extractor::ICAngle(const Mat &image, Point2f pt)
         }
         m_01 += v * v_sum;
     }
+#if defined(__SSE2__)
+    m_10 += sum_epi32(sum_10);
+#endif
 
     return fastAtan2((float)m_01, (float)m_10);
 }
@@ -100,61 +431,198 @@ inline void Extractor::ComputeOrientation(const cv::Mat &image, std::vector<cv::
     }
 }
 
-void QuadTreeNode::DivideNode(QuadTreeNode &n1, QuadTreeNode &n2, QuadTreeNode &n3, QuadTreeNode &n4)
+void Extractor::ComputeBRIEF(const Mat &image, const KeyPoint &kp, float scale, uchar *descriptor)
 {
-    const int halfX = ceil(static_cast<float>(UR.x - UL.x) / 2);
-    const int halfY = ceil(static_cast<float>(BR.y - UL.y) / 2);
+    const int num_points = num_pattern_points;
+    const int step = (int)image.step;
+    const float angle = kp.angle * (float)(CV_PI / 180.f);
+    const float a = (float)cos(angle), b = (float)sin(angle);
+    const uchar *center = &image.at<uchar>(cvRound(kp.pt.y * scale), cvRound(kp.pt.x * scale));
+
+    // rotate the pattern
+    int offsets[num_points];
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 ma = _mm_set1_ps(a), mb = _mm_set1_ps(b);
+    int us[4], vs[4];
+    for (; i + 4 <= num_points; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&pattern_x_[i]), y = _mm_loadu_ps(&pattern_y_[i]);
+        _mm_storeu_si128((__m128i *)us, _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, ma), _mm_mul_ps(y, mb))));
+        _mm_storeu_si128((__m128i *)vs, _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, mb), _mm_mul_ps(y, ma))));
+        for (int j = 0; j < 4; j++)
+        {
+            offsets[i + j] = vs[j] * step + us[j];
+        }
+    }
+#endif
+    for (; i < num_points; i++)
+    {
+        offsets[i] = cvRound(pattern_x_[i] * b + pattern_y_[i] * a) * step + cvRound(pattern_x_[i] * a - pattern_y_[i] * b);
+    }
+
+    // sample the patch
+    uchar values[num_points];
+    for (i = 0; i < num_points; i++)
+    {
+        values[i] = center[offsets[i]];
+    }
+
+    // compare pairs, bit j of byte k is values[2 * (8 * k + j)] < values[2 * (8 * k + j) + 1]
+    i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x00ff), zero = _mm_setzero_si128();
+    for (; i + 32 <= num_points; i += 32)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(values + i + 16));
+        __m128i t0 = _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+        __m128i t1 = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        int bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(t1, t0), zero)) & 0xffff;
+        descriptor[i / 16] = (uchar)bits;
+        descriptor[i / 16 + 1] = (uchar)(bits >> 8);
+    }
+#endif
+    for (; i < num_points; i += 16)
+    {
+        int val = 0;
+        for (int j = 0; j < 8; j++)
+        {
+            val |= (values[i + 2 * j] < values[i + 2 * j + 1]) << j;
+        }
+        descriptor[i / 16] = (uchar)val;
+    }
+}
+
+QuadTree::QuadTree(const vector<cv::KeyPoint> &kps, int num_init_nodes, float width, int height)
+    : kps_(kps), head_(-1), size_(0)
+{
+    nodes.reserve(num_init_nodes + 4 * kps.size());
+    indices.resize(kps.size());
+    buffer_.resize(kps.size());
+
+    // associate points to initial nodes, keep the order of points
+    vector<int> offsets(num_init_nodes + 1, 0);
+    for (size_t i = 0; i < kps.size(); i++)
+    {
+        buffer_[i] = std::min((int)(kps[i].pt.x / width), num_init_nodes - 1);
+        offsets[buffer_[i] + 1]++;
+    }
+    for (int i = 0; i < num_init_nodes; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    vector<int> tails(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < kps.size(); i++)
+    {
+        indices[tails[buffer_[i]]++] = i;
+    }
+
+    // push front from the last one, empty nodes are ignored
+    for (int i = num_init_nodes - 1; i >= 0; i--)
+    {
+        QuadTreeNode node;
+        node.UL = cv::Point2i(width * static_cast<float>(i), 0);
+        node.UR = cv::Point2i(width * static_cast<float>(i + 1), 0);
+        node.BL = cv::Point2i(node.UL.x, height);
+        node.BR = cv::Point2i(node.UR.x, height);
+        node.begin = offsets[i];
+        node.end = offsets[i + 1];
+        node.no_more = node.Size() == 1;
+        if (node.Size() > 0)
+        {
+            PushFront(node);
+        }
+    }
+}
+
+int QuadTree::PushFront(const QuadTreeNode &node)
+{
+    int i = nodes.size();
+    nodes.push_back(node);
+    nodes[i].prev = -1;
+    nodes[i].next = head_;
+    if (head_ != -1)
+    {
+        nodes[head_].prev = i;
+    }
+    head_ = i;
+    size_++;
+    return i;
+}
+
+void QuadTree::Erase(int i)
+{
+    QuadTreeNode &node = nodes[i];
+    if (node.prev != -1)
+    {
+        nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        head_ = node.next;
+    }
+    if (node.next != -1)
+    {
+        nodes[node.next].prev = node.prev;
+    }
+    size_--;
+}
+
+void QuadTree::DivideNode(int i, QuadTreeNode children[4])
+{
+    const QuadTreeNode &node = nodes[i];
+    const int halfX = ceil(static_cast<float>(node.UR.x - node.UL.x) / 2);
+    const int halfY = ceil(static_cast<float>(node.BR.y - node.UL.y) / 2);
 
     //Define boundaries of childs
-    n1.UL = UL;
-    n1.UR = cv::Point2i(UL.x + halfX, UL.y);
-    n1.BL = cv::Point2i(UL.x, UL.y + halfY);
-    n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
-    n1.kps.reserve(kps.size());
+    QuadTreeNode &n1 = children[0], &n2 = children[1], &n3 = children[2], &n4 = children[3];
+    n1.UL = node.UL;
+    n1.UR = cv::Point2i(node.UL.x + halfX, node.UL.y);
+    n1.BL = cv::Point2i(node.UL.x, node.UL.y + halfY);
+    n1.BR = cv::Point2i(node.UL.x + halfX, node.UL.y + halfY);
 
     n2.UL = n1.UR;
-    n2.UR = UR;
+    n2.UR = node.UR;
     n2.BL = n1.BR;
-    n2.BR = cv::Point2i(UR.x, UL.y + halfY);
-    n2.kps.reserve(kps.size());
+    n2.BR = cv::Point2i(node.UR.x, node.UL.y + halfY);
 
     n3.UL = n1.BL;
     n3.UR = n1.BR;
-    n3.BL = BL;
-    n3.BR = cv::Point2i(n1.BR.x, BL.y);
-    n3.kps.reserve(kps.size());
+    n3.BL = node.BL;
+    n3.BR = cv::Point2i(n1.BR.x, node.BL.y);
 
     n4.UL = n3.UR;
     n4.UR = n2.BR;
     n4.BL = n3.BR;
-    n4.BR = BR;
-    n4.kps.reserve(kps.size());
+    n4.BR = node.BR;
 
-    //Associate points to childs
-    for (size_t i = 0; i < kps.size(); i++)
-    {
-        const cv::KeyPoint &kp = kps[i];
+    //Associate points to childs, stable partition of the range
+    auto child_of = [&](int k) {
+        const cv::KeyPoint &kp = kps_[indices[k]];
         if (kp.pt.x < n1.UR.x)
-        {
-            if (kp.pt.y < n1.BR.y)
-                n1.kps.push_back(kp);
-            else
-                n3.kps.push_back(kp);
-        }
-        else if (kp.pt.y < n1.BR.y)
-            n2.kps.push_back(kp);
+            return kp.pt.y < n1.BR.y ? 0 : 2;
         else
-            n4.kps.push_back(kp);
+            return kp.pt.y < n1.BR.y ? 1 : 3;
+    };
+    int counts[4] = {0, 0, 0, 0};
+    for (int k = node.begin; k < node.end; k++)
+    {
+        counts[child_of(k)]++;
     }
 
-    if (n1.kps.size() == 1)
-        n1.no_more = true;
-    if (n2.kps.size() == 1)
-        n2.no_more = true;
-    if (n3.kps.size() == 1)
-        n3.no_more = true;
-    if (n4.kps.size() == 1)
-        n4.no_more = true;
+    int tails[4];
+    for (int j = 0, begin = node.begin; j < 4; j++)
+    {
+        children[j].begin = tails[j] = begin;
+        children[j].end = begin += counts[j];
+        children[j].no_more = counts[j] == 1;
+    }
+    for (int k = node.begin; k < node.end; k++)
+    {
+        buffer_[tails[child_of(k)]++] = indices[k];
+    }
+    std::copy(buffer_.begin() + node.begin, buffer_.begin() + node.end, indices.begin() + node.begin);
 }
 
 vector<cv::KeyPoint> Extractor::DistributeQuadTree(
@@ -164,180 +632,87 @@ vector<cv::KeyPoint> Extractor::DistributeQuadTree(
     // compute how many initial nodes
     const int num_init_nodes = round(static_cast<float>(max_x - min_x) / (max_y - min_y));
     const float height = static_cast<float>(max_x - min_x) / num_init_nodes;
-    list<QuadTreeNode> list_nodes;
-    vector<QuadTreeNode *> init_nodes;
-    init_nodes.resize(num_init_nodes);
-    for (int i = 0; i < num_init_nodes; i++)
-    {
-        QuadTreeNode node;
-        node.UL = cv::Point2i(height * static_cast<float>(i), 0);
-        node.UR = cv::Point2i(height * static_cast<float>(i + 1), 0);
-        node.BL = cv::Point2i(node.UL.x, max_y - min_y);
-        node.BR = cv::Point2i(node.UR.x, max_y - min_y);
-        node.kps.reserve(distribute_kps.size());
-
-        list_nodes.push_back(node);
-        init_nodes[i] = &list_nodes.back();
-    }
-
-    // associate points to childs
-    for (size_t i = 0; i < distribute_kps.size(); i++)
-    {
-        const cv::KeyPoint &kp = distribute_kps[i];
-        init_nodes[kp.pt.x / height]->kps.push_back(kp);
-    }
-
-    auto iter = list_nodes.begin();
-    while (iter != list_nodes.end())
-    {
-        if (iter->kps.size() == 1)
-        {
-            iter->no_more = true;
-            iter++;
-        }
-        else if (iter->kps.empty())
-            iter = list_nodes.erase(iter);
-        else
-            iter++;
-    }
+    QuadTree tree(distribute_kps, num_init_nodes, height, max_y - min_y);
 
     bool finished = false;
     int iteration = 0;
-    vector<pair<int, QuadTreeNode *>> size_and_nodes;
-    size_and_nodes.reserve(list_nodes.size() * 4);
+    QuadTreeNode children[4];
+    vector<pair<int, int>> size_and_nodes, prev_size_and_nodes;
+    size_and_nodes.reserve(distribute_kps.size());
+    prev_size_and_nodes.reserve(distribute_kps.size());
     while (!finished)
     {
         iteration++;
-        int prev_size = list_nodes.size();
-        iter = list_nodes.begin();
+        int prev_size = tree.Size();
         int num_expand = 0;
         size_and_nodes.clear();
-        while (iter != list_nodes.end())
+        int i = tree.Begin();
+        while (i != -1)
         {
-            if (iter->no_more)
-            {
-                // If node only contains one point do not subdivide and continue
-                iter++;
-                continue;
-            }
-            else
+            int next = tree.nodes[i].next;
+            // If node only contains one point do not subdivide and continue
+            if (!tree.nodes[i].no_more)
             {
                 // If more than one point, subdivide
-                QuadTreeNode n1, n2, n3, n4;
-                iter->DivideNode(n1, n2, n3, n4);
+                tree.DivideNode(i, children);
 
                 // Add childs if they contain points
-                if (n1.kps.size() > 0)
-                {
-                    list_nodes.push_front(n1);
-                    if (n1.kps.size() > 1)
-                    {
-                        num_expand++;
-                        size_and_nodes.push_back(make_pair(n1.kps.size(), &list_nodes.front()));
-                        list_nodes.front().iter = list_nodes.begin();
-                    }
-                }
-                if (n2.kps.size() > 0)
+                for (auto &child : children)
                 {
-                    list_nodes.push_front(n2);
-                    if (n2.kps.size() > 1)
+                    if (child.Size() > 0)
                     {
-                        num_expand++;
-                        size_and_nodes.push_back(make_pair(n2.kps.size(), &list_nodes.front()));
-                        list_nodes.front().iter = list_nodes.begin();
-                    }
-                }
-                if (n3.kps.size() > 0)
-                {
-                    list_nodes.push_front(n3);
-                    if (n3.kps.size() > 1)
-                    {
-                        num_expand++;
-                        size_and_nodes.push_back(make_pair(n3.kps.size(), &list_nodes.front()));
-                        list_nodes.front().iter = list_nodes.begin();
-                    }
-                }
-                if (n4.kps.size() > 0)
-                {
-                    list_nodes.push_front(n4);
-                    if (n4.kps.size() > 1)
-                    {
-                        num_expand++;
-                        size_and_nodes.push_back(make_pair(n4.kps.size(), &list_nodes.front()));
-                        list_nodes.front().iter = list_nodes.begin();
+                        int j = tree.PushFront(child);
+                        if (child.Size() > 1)
+                        {
+                            num_expand++;
+                            size_and_nodes.push_back(make_pair(child.Size(), j));
+                        }
                     }
                 }
 
-                iter = list_nodes.erase(iter);
-                continue;
+                tree.Erase(i);
             }
+            i = next;
         }
 
         // Finish if there are more nodes than required features
         // or all nodes contain just one point
-        if ((int)list_nodes.size() >= num || (int)list_nodes.size() == prev_size)
+        if (tree.Size() >= num || tree.Size() == prev_size)
         {
             finished = true;
         }
-        else if (((int)list_nodes.size() + num_expand * 3) > num)
+        else if ((tree.Size() + num_expand * 3) > num)
         {
-
             while (!finished)
             {
-                prev_size = list_nodes.size();
-                vector<pair<int, QuadTreeNode *>> prev_size_and_node = size_and_nodes;
+                prev_size = tree.Size();
+                prev_size_and_nodes.swap(size_and_nodes);
                 size_and_nodes.clear();
-                sort(prev_size_and_node.begin(), prev_size_and_node.end());
-                for (int j = prev_size_and_node.size() - 1; j >= 0; j--)
+                sort(prev_size_and_nodes.begin(), prev_size_and_nodes.end());
+                for (int j = prev_size_and_nodes.size() - 1; j >= 0; j--)
                 {
-                    QuadTreeNode n1, n2, n3, n4;
-                    prev_size_and_node[j].second->DivideNode(n1, n2, n3, n4);
+                    tree.DivideNode(prev_size_and_nodes[j].second, children);
 
                     // Add childs if they contain points
-                    if (n1.kps.size() > 0)
+                    for (auto &child : children)
                     {
-                        list_nodes.push_front(n1);
-                        if (n1.kps.size() > 1)
+                        if (child.Size() > 0)
                         {
-                            size_and_nodes.push_back(make_pair(n1.kps.size(), &list_nodes.front()));
-                            list_nodes.front().iter = list_nodes.begin();
-                        }
-                    }
-                    if (n2.kps.size() > 0)
-                    {
-                        list_nodes.push_front(n2);
-                        if (n2.kps.size() > 1)
-                        {
-                            size_and_nodes.push_back(make_pair(n2.kps.size(), &list_nodes.front()));
-                            list_nodes.front().iter = list_nodes.begin();
-                        }
-                    }
-                    if (n3.kps.size() > 0)
-                    {
-                        list_nodes.push_front(n3);
-                        if (n3.kps.size() > 1)
-                        {
-                            size_and_nodes.push_back(make_pair(n3.kps.size(), &list_nodes.front()));
-                            list_nodes.front().iter = list_nodes.begin();
-                        }
-                    }
-                    if (n4.kps.size() > 0)
-                    {
-                        list_nodes.push_front(n4);
-                        if (n4.kps.size() > 1)
-                        {
-                            size_and_nodes.push_back(make_pair(n4.kps.size(), &list_nodes.front()));
-                            list_nodes.front().iter = list_nodes.begin();
+                            int k = tree.PushFront(child);
+                            if (child.Size() > 1)
+                            {
+                                size_and_nodes.push_back(make_pair(child.Size(), k));
+                            }
                         }
                     }
 
-                    list_nodes.erase(prev_size_and_node[j].second->iter);
+                    tree.Erase(prev_size_and_nodes[j].second);
 
-                    if ((int)list_nodes.size() >= num)
+                    if (tree.Size() >= num)
                         break;
                 }
 
-                if ((int)list_nodes.size() >= num || (int)list_nodes.size() == prev_size)
+                if (tree.Size() >= num || tree.Size() == prev_size)
                     finished = true;
             }
         }
@@ -346,39 +721,43 @@ vector<cv::KeyPoint> Extractor::DistributeQuadTree(
     // Retain the best point in each node
     vector<cv::KeyPoint> result;
     result.reserve(num_features);
-    for (auto iter = list_nodes.begin(); iter != list_nodes.end(); iter++)
+    for (int i = tree.Begin(); i != -1; i = tree.nodes[i].next)
     {
-        vector<cv::KeyPoint> &kps = iter->kps;
-        cv::KeyPoint *kp = &kps[0];
-        float max_response = kp->response;
-        for (int i = 1; i < kps.size(); i++)
+        const QuadTreeNode &node = tree.nodes[i];
+        int best = tree.indices[node.begin];
+        for (int k = node.begin + 1; k < node.end; k++)
         {
-            if (kps[i].response > max_response)
+            if (distribute_kps[tree.indices[k]].response > distribute_kps[best].response)
             {
-                kp = &kps[i];
-                max_response = kps[i].response;
+                best = tree.indices[k];
             }
         }
-        result.push_back(*kp);
+        result.push_back(distribute_kps[best]);
     }
 
     return result;
 }
 
-void Extractor::ComputeKeyPointsQuadTree(vector<vector<KeyPoint>> &all_kps)
+void Extractor::ComputeKeyPointsQuadTree(const ImagePyramid &pyramid, vector<vector<KeyPoint>> &all_kps)
 {
     all_kps.resize(num_levels);
 
+    // split all levels into cells, FAST in every cell is independent
+    struct Cell
+    {
+        int level;
+        int min_x, max_x, min_y, max_y;
+        int offset_x, offset_y;
+    };
+    vector<Cell> cells;
+    vector<int> level_cells(num_levels + 1, 0);
     const float W = 30;
     for (int level = 0; level < num_levels; level++)
     {
         const int min_border_x = edge_thershold - 3;
         const int min_border_Y = min_border_x;
-        const int max_border_X = image_pyramid_[level].cols - edge_thershold + 3;
-        const int max_border_Y = image_pyramid_[level].rows - edge_thershold + 3;
-
-        vector<cv::KeyPoint> distribute_kps;
-        distribute_kps.reserve(num_features * 10);
+        const int max_border_X = pyramid.images[level].cols - edge_thershold + 3;
+        const int max_border_Y = pyramid.images[level].rows - edge_thershold + 3;
 
         const float width = (max_border_X - min_border_x);
         const float height = (max_border_Y - min_border_Y);
@@ -406,85 +785,122 @@ void Extractor::ComputeKeyPointsQuadTree(vector<vector<KeyPoint>> &all_kps)
                 if (max_x > max_border_X)
                     max_x = max_border_X;
 
-                vector<cv::KeyPoint> cell_kps;
-                FAST(image_pyramid_[level].rowRange(init_y, max_y).colRange(init_x, max_x),
-                     cell_kps, init_FAST_thershold, true);
+                Cell cell;
+                cell.level = level;
+                cell.min_x = init_x;
+                cell.max_x = max_x;
+                cell.min_y = init_y;
+                cell.max_y = max_y;
+                cell.offset_x = j * cell_width;
+                cell.offset_y = i * cell_height;
+                cells.push_back(cell);
+            }
+        }
+        level_cells[level + 1] = cells.size();
+    }
 
-                if (cell_kps.empty())
-                {
-                    FAST(image_pyramid_[level].rowRange(init_y, max_y).colRange(init_x, max_x),
-                         cell_kps, min_FAST_thershold, true);
-                }
+    vector<vector<KeyPoint>> cells_kps(cells.size());
+    parallel_for(cells.size(), [&](int k) {
+        const Cell &cell = cells[k];
+        Mat roi = pyramid.images[cell.level].rowRange(cell.min_y, cell.max_y).colRange(cell.min_x, cell.max_x);
+        vector<KeyPoint> &cell_kps = cells_kps[k];
+        FAST(roi, cell_kps, init_FAST_thershold, true);
 
-                if (!cell_kps.empty())
-                {
-                    for (auto vit = cell_kps.begin(); vit != cell_kps.end(); vit++)
-                    {
-                        (*vit).pt.x += j * cell_width;
-                        (*vit).pt.y += i * cell_height;
-                        distribute_kps.push_back(*vit);
-                    }
-                }
-            }
+        if (cell_kps.empty())
+        {
+            FAST(roi, cell_kps, min_FAST_thershold, true);
         }
 
-        vector<KeyPoint> &level_kps = all_kps[level];
-        level_kps.reserve(num_features);
+        for (auto &kp : cell_kps)
+        {
+            kp.pt.x += cell.offset_x;
+            kp.pt.y += cell.offset_y;
+        }
+    });
+
+    // distribute and compute orientations, levels are independent
+    parallel_for(num_levels, [&](int level) {
+        const int min_border_x = edge_thershold - 3;
+        const int min_border_Y = min_border_x;
+        const int max_border_X = pyramid.images[level].cols - edge_thershold + 3;
+        const int max_border_Y = pyramid.images[level].rows - edge_thershold + 3;
+
+        // keep the same order as scanning cells row by row
+        int num_kps = 0;
+        for (int k = level_cells[level]; k < level_cells[level + 1]; k++)
+        {
+            num_kps += cells_kps[k].size();
+        }
+        vector<cv::KeyPoint> distribute_kps;
+        distribute_kps.reserve(num_kps);
+        for (int k = level_cells[level]; k < level_cells[level + 1]; k++)
+        {
+            distribute_kps.insert(distribute_kps.end(), cells_kps[k].begin(), cells_kps[k].end());
+        }
 
+        vector<KeyPoint> &level_kps = all_kps[level];
         level_kps = DistributeQuadTree(distribute_kps, min_border_x, max_border_X,
                                        min_border_Y, max_border_Y, num_desired_features_[level], level);
 
         const int scaled_patch_size = patch_size * scale_factor_per_levels_[level];
 
         // Add border to coordinates and scale information
-        const int nkps = level_kps.size();
-        for (int i = 0; i < nkps; i++)
+        for (auto &kp : level_kps)
         {
-            level_kps[i].pt.x += min_border_x;
-            level_kps[i].pt.y += min_border_Y;
-            level_kps[i].octave = level;
-            level_kps[i].size = scaled_patch_size;
+            kp.pt.x += min_border_x;
+            kp.pt.y += min_border_Y;
+            kp.octave = level;
+            kp.size = scaled_patch_size;
         }
-    }
 
-    // compute orientations
-    for (int level = 0; level < num_levels; level++)
-        ComputeOrientation(image_pyramid_[level], all_kps[level]);
+        ComputeOrientation(pyramid.images[level], level_kps);
+    });
 }
 
-void Extractor::ComputePyramid(cv::Mat image)
+void Extractor::ComputePyramid(cv::Mat image, ImagePyramid &pyramid)
 {
+    pyramid.images.resize(num_levels);
+    pyramid.blurred.resize(num_levels);
+    vector<Mat> bordered(num_levels);
     for (int level = 0; level < num_levels; level++)
     {
         float scale = inv_scale_factor_per_levels_[level];
         Size sz(cvRound((float)image.cols * scale), cvRound((float)image.rows * scale));
         Size whole_size(sz.width + edge_thershold * 2, sz.height + edge_thershold * 2);
-        Mat temp(whole_size, image.type());
-        image_pyramid_[level] = temp(Rect(edge_thershold, edge_thershold, sz.width, sz.height));
+        Mat &temp = bordered[level];
+        temp.create(whole_size, image.type());
+        pyramid.images[level] = temp(Rect(edge_thershold, edge_thershold, sz.width, sz.height));
 
         // Compute the resized image
         if (level != 0)
         {
-            resize(image_pyramid_[level - 1], image_pyramid_[level], sz, 0, 0, INTER_LINEAR);
+            resize(pyramid.images[level - 1], pyramid.images[level], sz, 0, 0, INTER_LINEAR);
 
-            copyMakeBorder(image_pyramid_[level], temp, edge_thershold, edge_thershold, edge_thershold, edge_thershold, BORDER_REFLECT_101 + BORDER_ISOLATED);
+            copyMakeBorder(pyramid.images[level], temp, edge_thershold, edge_thershold, edge_thershold, edge_thershold, BORDER_REFLECT_101 + BORDER_ISOLATED);
         }
         else
         {
             copyMakeBorder(image, temp, edge_thershold, edge_thershold, edge_thershold, edge_thershold, BORDER_REFLECT_101);
         }
     }
+
+    // preprocess the resized images for descriptors
+    parallel_for(num_levels, [&](int level) {
+        Mat blurred;
+        GaussianBlur(bordered[level], blurred, Size(7, 7), 2, 2, BORDER_REFLECT_101);
+        pyramid.blurred[level] = blurred(Rect(edge_thershold, edge_thershold, pyramid.images[level].cols, pyramid.images[level].rows));
+    });
 }
 
-void Extractor::Detect(Mat image, vector<vector<KeyPoint>> &keypoints)
+void Extractor::Detect(Mat image, ImagePyramid &pyramid, vector<vector<KeyPoint>> &keypoints)
 {
     keypoints.clear();
     assert(image.type() == CV_8UC1);
 
     // Pre-compute the scale pyramid
-    ComputePyramid(image);
+    ComputePyramid(image, pyramid);
 
-    ComputeKeyPointsQuadTree(keypoints);
+    ComputeKeyPointsQuadTree(pyramid, keypoints);
 
     for (int level = 1; level < num_levels; level++)
     {
@@ -501,31 +917,29 @@ void Extractor::Detect(Mat image, vector<vector<KeyPoint>> &keypoints)
     }
 }
 
-Mat Extractor::Compute(vector<vector<KeyPoint>> &keypoints)
+// one contiguous block of descriptors, each row is aligned to 32 bytes
+inline Mat aligned_descriptors(int n)
 {
-    static Ptr<ORB> orb = ORB::create();
-    int num_kps = 0;
-    for (auto &kps_level : keypoints)
-        num_kps += kps_level.size();
+    if (n == 0)
+        return Mat(0, 32, CV_8U);
+    Mat buffer(1, (n + 1) * 32, CV_8U);
+    int offset = (32 - (size_t)buffer.data % 32) % 32;
+    return buffer.colRange(offset, offset + n * 32).reshape(1, n);
+}
 
-    Mat descriptors = Mat::zeros(num_kps, 32, CV_8U);
-    int offset = 0;
+Mat Extractor::Compute(const ImagePyramid &pyramid, vector<vector<KeyPoint>> &keypoints)
+{
+    vector<int> offsets(num_levels + 1, 0);
     for (int level = 0; level < num_levels; level++)
-    {
-        vector<KeyPoint> &kps_level = keypoints[level];
-        int size = kps_level.size();
-        if (size == 0)
-            continue;
-
-        // preprocess the resized image
-        Mat current_image = image_pyramid_[level].clone();
-        GaussianBlur(current_image, current_image, Size(7, 7), 2, 2, BORDER_REFLECT_101);
-
-        // compute the descriptors
-        Mat desc = descriptors.rowRange(offset, offset + size);
-        orb->compute(current_image, kps_level, desc);
-        offset += size;
-    }
+        offsets[level + 1] = offsets[level] + keypoints[level].size();
+
+    // the keypoints are in the coordinates of level 0
+    Mat descriptors = aligned_descriptors(offsets[num_levels]);
+    parallel_for(offsets[num_levels], [&](int i) {
+        int level = upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin() - 1;
+        ComputeBRIEF(pyramid.blurred[level], keypoints[level][i - offsets[level]],
+                     inv_scale_factor_per_levels_[level], descriptors.ptr(i));
+    });
     return descriptors;
 }
 
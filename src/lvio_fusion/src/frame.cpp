@@ -1,5 +1,6 @@
 #include "lvio_fusion/frame.h"
 #include "lvio_fusion/map.h"
+#include "lvio_fusion/utility.h"
 #include "lvio_fusion/visual/camera.h"
 #include "lvio_fusion/visual/landmark.h"
 
@@ -24,22 +25,67 @@ Frame::Ptr Frame::Create()
 
 void Frame::AddFeature(visual::Feature::Ptr feature)
 {
-    auto landmark = feature->landmark.lock();
+    auto landmark = feature->landmark.get();
     assert(feature->frame.lock()->id == id && landmark);
     if (feature->is_on_left_image)
     {
-        features_left[landmark->id] = feature;
+        features_left.insert_or_assign(landmark->id, feature);
     }
     else
     {
-        features_right[landmark->id] = feature;
+        features_right.insert_or_assign(landmark->id, feature);
     }
 }
 
 void Frame::RemoveFeature(visual::Feature::Ptr feature)
 {
-    assert(feature->is_on_left_image && id != feature->landmark.lock()->FirstFrame().lock()->id);
-    int a = features_left.erase(feature->landmark.lock()->id);
+    assert(feature->is_on_left_image && id != feature->landmark.get()->FirstFrame().lock()->id);
+    int a = features_left.erase(feature->landmark.get()->id);
+}
+
+void Frame::SetImageRight(const cv::Mat &raw)
+{
+    image_right_raw_ = raw;
+    image_right_ = cv::Mat();
+}
+
+const cv::Mat &Frame::GetImageRight()
+{
+    if (image_right_.empty() && !image_right_raw_.empty())
+    {
+        // the same as the left image in preprocessing
+        cv::equalizeHist(image_right_raw_, image_right_raw_);
+        Camera::Get(1)->Undistort(image_right_raw_, image_right_);
+        image_right_raw_ = cv::Mat();
+    }
+    return image_right_;
+}
+
+const std::vector<cv::Mat> &Frame::GetPyramidLeft()
+{
+    if (pyramid_left_.empty())
+    {
+        build_optical_flow_pyramid(image_left, pyramid_left_);
+    }
+    return pyramid_left_;
+}
+
+const std::vector<cv::Mat> &Frame::GetPyramidRight()
+{
+    if (pyramid_right_.empty())
+    {
+        build_optical_flow_pyramid(GetImageRight(), pyramid_right_);
+    }
+    return pyramid_right_;
+}
+
+void Frame::ReleaseBuffers()
+{
+    pyramid_left_.clear();
+    pyramid_right_.clear();
+    image_right_ = cv::Mat();
+    image_right_raw_ = cv::Mat();
+    orb_pyramid = ImagePyramid();
 }
 
 Observation Frame::GetObservation()
@@ -50,11 +96,12 @@ Observation Frame::GetObservation()
     int height = image_left.rows, width = image_left.cols;
     for (auto &pair_feature : features_left)
     {
-        auto observations = pair_feature.second->landmark.lock()->observations;
-        if (observations.find(id - 1) != observations.end())
+        auto landmark = pair_feature.second->landmark.get();
+        auto iter = landmark->observations.find(id - 1);
+        if (iter != landmark->observations.end())
         {
             auto pt = pair_feature.second->keypoint.pt;
-            auto prev_pt = observations[id - 1]->keypoint.pt;
+            auto prev_pt = iter->second->keypoint.pt;
             int row = (int)(pt.y / (height / obs_rows));
             int col = (int)(pt.x / (width / obs_cols));
             obs.at<cv::Vec3f>(row, col)[0] += 1;
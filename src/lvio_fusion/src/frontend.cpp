@@ -1,11 +1,15 @@
 #include "lvio_fusion/frontend.h"
 #include "lvio_fusion/backend.h"
+#include "lvio_fusion/imu/tools.h"
+#include "lvio_fusion/loop/pose_graph.h"
 #include "lvio_fusion/map.h"
 #include "lvio_fusion/navsat/navsat.h"
 #include "lvio_fusion/utility.h"
 #include "lvio_fusion/visual/camera.h"
 #include "lvio_fusion/visual/feature.h"
+#include "lvio_fusion/visual/klt.h"
 #include "lvio_fusion/visual/landmark.h"
+#include "lvio_fusion/visual/painter.h"
 
 namespace lvio_fusion
 {
@@ -15,12 +19,12 @@ Frontend::Frontend(int num_features, int init, int tracking, int tracking_bad, i
 {
 }
 
-cv::Mat img_track;
 bool Frontend::AddFrame(Frame::Ptr frame)
 {
     std::unique_lock<std::mutex> lock(mutex);
+    UpdateState();
     current_frame = frame;
-    cv::cvtColor(current_frame->image_left, img_track, cv::COLOR_GRAY2RGB);
+    Painter::Instance().Begin(current_frame->image_left);
     switch (status)
     {
     case FrontendStatus::BUILDING:
@@ -33,8 +37,12 @@ bool Frontend::AddFrame(Frame::Ptr frame)
         Track();
         break;
     }
-    cv::imshow("tracking", img_track);
-    cv::waitKey(1);
+    Painter::Instance().End();
+    // buffers are only reused by the next frame
+    if (last_frame)
+    {
+        last_frame->ReleaseBuffers();
+    }
     last_frame = current_frame;
     last_frame_pose_cache_ = last_frame->pose;
     return true;
@@ -42,7 +50,20 @@ bool Frontend::AddFrame(Frame::Ptr frame)
 
 void Frontend::AddImu(double time, Vector3d acc, Vector3d gyr)
 {
-    imu_buf_.push(ImuData(acc, gyr, time));
+    imu_integrator_.AddImu(ImuData(acc, gyr, time));
+}
+
+void Frontend::AddImu(const std::vector<ImuData> &data)
+{
+    imu_integrator_.AddImu(data);
+}
+
+void Frontend::ExpectFrame(double time)
+{
+    if (Imu::Num())
+    {
+        imu_integrator_.AddFrame(time);
+    }
 }
 
 bool check_velocity(SE3d &current_pose, SE3d last_pose, double dt)
@@ -138,7 +159,7 @@ void Frontend::ResetImu()
 int Frontend::TrackLastFrame()
 {
     std::vector<cv::Point2f> kps_last, kps_current;
-    std::vector<visual::Landmark::Ptr> landmarks;
+    std::vector<Handle<visual::Landmark>> landmarks;
     std::vector<uchar> status;
     // use LK flow to estimate points in the last image
     kps_last.reserve(last_frame->features_left.size());
@@ -147,11 +168,11 @@ int Frontend::TrackLastFrame()
     {
         // use project point
         auto feature = pair.second;
-        auto landmark = feature->landmark.lock();
+        auto landmark = feature->landmark.get();
         auto px = Camera::Get()->World2Pixel(local_map.position_cache[landmark->id], current_frame->pose);
         kps_last.push_back(feature->keypoint.pt);
         kps_current.push_back(cv::Point2f(px[0], px[1]));
-        landmarks.push_back(landmark);
+        landmarks.push_back(feature->landmark);
     }
     // if last frame is a key frame, use new landmarks
     if (last_frame == last_keyframe)
@@ -161,14 +182,29 @@ int Frontend::TrackLastFrame()
         kps_current.reserve(kps_current.size() + features.size());
         for (auto &feature : features)
         {
-            auto landmark = feature->landmark.lock();
+            auto landmark = feature->landmark.get();
             auto px = Camera::Get()->World2Pixel(local_map.position_cache[landmark->id], current_frame->pose);
             kps_last.push_back(feature->keypoint.pt);
             kps_current.push_back(cv::Point2f(px[0], px[1]));
-            landmarks.push_back(landmark);
+            landmarks.push_back(feature->landmark);
+        }
+    }
+    // the predicted motion decides the window and levels of KLT,
+    // the pose is not predicted if it is the last one (after initialization, lost or reset)
+    bool predicted = (last_frame_pose_cache_.inverse() * current_frame->pose).log().norm() > 1e-6;
+    double motion = 0;
+    if (predicted && !kps_last.empty())
+    {
+        std::vector<double> motions(kps_last.size());
+        for (int i = 0; i < kps_last.size(); i++)
+        {
+            motions[i] = cv_distance(kps_last[i], kps_current[i]);
         }
+        std::nth_element(motions.begin(), motions.begin() + motions.size() / 2, motions.end());
+        motion = motions[motions.size() / 2];
     }
-    optical_flow(last_frame->image_left, current_frame->image_left, kps_last, kps_current, status);
+    KLT klt = predicted ? KLT::Adapt(motion) : KLT();
+    klt.Track(last_frame->GetPyramidLeft(), current_frame->GetPyramidLeft(), kps_last, kps_current, status);
     // TODO
     // Solve PnP
     std::vector<cv::Point3f> points_3d_far, points_3d_near;
@@ -178,18 +214,18 @@ int Frontend::TrackLastFrame()
     {
         if (status[i])
         {
-            if (Camera::Get()->Far(local_map.position_cache[landmarks[i]->id], current_frame->pose))
+            if (Camera::Get()->Far(local_map.position_cache[landmarks[i].get()->id], current_frame->pose))
             {
                 map_far.push_back(i);
                 points_2d_far.push_back(kps_current[i]);
-                Vector3d pw = local_map.position_cache[landmarks[i]->id];
+                Vector3d pw = local_map.position_cache[landmarks[i].get()->id];
                 points_3d_far.push_back(cv::Point3f(pw.x(), pw.y(), pw.z()));
             }
             else
             {
                 map_near.push_back(i);
                 points_2d_near.push_back(kps_current[i]);
-                Vector3d pw = local_map.position_cache[landmarks[i]->id];
+                Vector3d pw = local_map.position_cache[landmarks[i].get()->id];
                 points_3d_near.push_back(cv::Point3f(pw.x(), pw.y(), pw.z()));
             }
         }
@@ -222,8 +258,7 @@ int Frontend::TrackLastFrame()
                 for (int r = 0; r < inliers.rows; r++)
                 {
                     int i = map_near[inliers.at<int>(r)];
-                    cv::arrowedLine(img_track, kps_current[i], kps_last[i], cv::Scalar(0, 255, 0), 1, 8, 0, 0.2);
-                    cv::circle(img_track, kps_current[i], 2, cv::Scalar(0, 255, 0), cv::FILLED);
+                    Painter::Instance().Arrow(kps_current[i], kps_last[i], cv::Scalar(0, 255, 0));
                     auto feature = visual::Feature::Create(current_frame, cv::KeyPoint(kps_current[i], 1), landmarks[i]);
                     current_frame->AddFeature(feature);
                     num_good_pts++;
@@ -234,8 +269,7 @@ int Frontend::TrackLastFrame()
         {
             for (auto &i : map_near)
             {
-                cv::arrowedLine(img_track, kps_current[i], kps_last[i], cv::Scalar(0, 255, 0), 1, 8, 0, 0.2);
-                cv::circle(img_track, kps_current[i], 2, cv::Scalar(0, 255, 0), cv::FILLED);
+                Painter::Instance().Arrow(kps_current[i], kps_last[i], cv::Scalar(0, 255, 0));
                 auto feature = visual::Feature::Create(current_frame, cv::KeyPoint(kps_current[i], 1), landmarks[i]);
                 current_frame->AddFeature(feature);
                 num_good_pts++;
@@ -245,8 +279,7 @@ int Frontend::TrackLastFrame()
         // far
         for (auto &i : map_far)
         {
-            cv::arrowedLine(img_track, kps_current[i], kps_last[i], cv::Scalar(0, 0, 255), 1, 8, 0, 0.2);
-            cv::circle(img_track, kps_current[i], 2, cv::Scalar(0, 0, 255), cv::FILLED);
+            Painter::Instance().Arrow(kps_current[i], kps_last[i], cv::Scalar(0, 0, 255));
             auto feature = visual::Feature::Create(current_frame, cv::KeyPoint(kps_current[i], 1), landmarks[i]);
             current_frame->AddFeature(feature);
             num_good_pts++;
@@ -287,7 +320,7 @@ void Frontend::CreateKeyframe()
     for (auto &pair_feature : current_frame->features_left)
     {
         auto feature = pair_feature.second;
-        auto landmark = feature->landmark.lock();
+        auto landmark = feature->landmark.get();
         landmark->AddObservation(feature);
     }
     // detect new features, track in right image and triangulate map points
@@ -301,13 +334,48 @@ void Frontend::CreateKeyframe()
     backend_.lock()->UpdateMap();
 }
 
-void Frontend::UpdateCache()
+void Frontend::UpdateState()
 {
-    local_map.UpdateCache();
+    auto backend = backend_.lock();
+    if (!backend || !backend->TakeState(state_, init_time))
+        return;
+
+    if (last_frame)
+    {
+        // frames after the backend's window
+        FramesView active_kfs = Map::Instance().GetKeyFrames(state_.time);
+        PoseGraph::Instance().ForwardUpdate(state_.transform, active_kfs, last_frame);
+
+        // imu initialization of the backend is dropped if imu has been reset since it started
+        if (Imu::Num() && state_.init_time == init_time)
+        {
+            Imu::Get()->initialized = state_.initialized;
+        }
+
+        // update imu
+        if (Imu::Num() && Imu::Get()->initialized && state_.prior_frame)
+        {
+            // the only copy, as the last frame may not be a keyframe
+            Frames frames = active_kfs;
+            frames[last_frame->time] = last_frame;
+            imu::RePredictVel(frames, state_.prior_frame);
+            UpdateImu((--frames.end())->second->bias);
+        }
+
+        // update frontend landmarks and pose
+        UpdateCache(state_.poses, state_.positions);
+    }
+    backend->StateApplied(state_.version);
+}
+
+void Frontend::UpdateCache(const std::unordered_map<double, SE3d> &poses,
+                           const std::unordered_map<unsigned long, Vector3d> &positions)
+{
+    local_map.UpdateCache(poses, positions);
     for (auto &pair_feature : last_frame->features_left)
     {
         auto feature = pair_feature.second;
-        auto landmark = feature->landmark.lock();
+        auto landmark = feature->landmark.get();
         if (local_map.position_cache.find(landmark->id) == local_map.position_cache.end())
         {
             local_map.position_cache[landmark->id] = landmark->ToWorld();
@@ -345,84 +413,16 @@ void Frontend::UpdateImu(const Bias &bias_)
 
 void Frontend::Preintegrate()
 {
-    // get imu data fron last frame
-    std::vector<ImuData> imu_from_last_frame;
-    int timeout = dt_ * 1e3; // 100ms
-    while (timeout)
+    // imu data have been preintegrated in the background, wait at most one frame
+    imu::Preintegration::Ptr preintegration_last_frame;
+    if (!imu_integrator_.Take(current_frame->time, last_frame->bias, !preintegration_last_kf_, dt_,
+                              preintegration_last_frame, preintegration_last_kf_))
     {
-        if (imu_buf_.empty())
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            timeout--;
-            continue;
-        }
-        ImuData imu_data = imu_buf_.front();
-        if (imu_data.t < last_frame->time - epsilon)
-        {
-            imu_buf_.pop();
-        }
-        else if (imu_data.t < current_frame->time - epsilon)
-        {
-            imu_from_last_frame.push_back(imu_data);
-            imu_buf_.pop();
-        }
-        else
-        {
-            imu_from_last_frame.push_back(imu_data);
-            break;
-        }
-    }
-    // preintegrate
-    int n = imu_from_last_frame.size();
-    auto preintegration_last_frame = imu::Preintegration::Create(last_frame->bias);
-    preintegration_last_kf_ = preintegration_last_kf_ ? preintegration_last_kf_ : imu::Preintegration::Create(last_frame->bias);
-    if (n < 4)
-    {
-        // If n is smaller than 4, initialize again.
+        // If imu data are not enough, initialize again.
         ResetImu();
     }
     else
     {
-        for (int i = 0; i < n - 1; i++)
-        {
-            double tstep;
-            double tab;
-            Vector3d acc0, ang_vel0;
-            Vector3d acc, ang_vel;
-            if (i == 0)
-            {
-                tab = imu_from_last_frame[i + 1].t - imu_from_last_frame[i].t;
-                double tini = imu_from_last_frame[i].t - last_frame->time;
-                acc = imu_from_last_frame[i + 1].a;
-                acc0 = imu_from_last_frame[i].a - (imu_from_last_frame[i + 1].a - imu_from_last_frame[i].a) * (tini / tab);
-                ang_vel = imu_from_last_frame[i + 1].w;
-                ang_vel0 = imu_from_last_frame[i].w - (imu_from_last_frame[i + 1].w - imu_from_last_frame[i].w) * (tini / tab);
-                tstep = imu_from_last_frame[i + 1].t - last_frame->time;
-            }
-            else if (i < n - 2)
-            {
-                acc = imu_from_last_frame[i + 1].a;
-                acc0 = imu_from_last_frame[i].a;
-                ang_vel = imu_from_last_frame[i + 1].w;
-                ang_vel0 = imu_from_last_frame[i].w;
-                tstep = imu_from_last_frame[i + 1].t - imu_from_last_frame[i].t;
-            }
-            else if (i == n - 2)
-            {
-                tab = imu_from_last_frame[i + 1].t - imu_from_last_frame[i].t;
-                double tend = imu_from_last_frame[i + 1].t - current_frame->time;
-                acc = imu_from_last_frame[i + 1].a - (imu_from_last_frame[i + 1].a - imu_from_last_frame[i].a) * (tend / tab);
-                acc0 = imu_from_last_frame[i].a;
-                ang_vel = imu_from_last_frame[i + 1].w - (imu_from_last_frame[i + 1].w - imu_from_last_frame[i].w) * (tend / tab);
-                ang_vel0 = imu_from_last_frame[i].w;
-                tstep = current_frame->time - imu_from_last_frame[i].t;
-            }
-            if (tab == 0)
-                continue;
-            preintegration_last_kf_->Append(tstep, acc, ang_vel, acc0, ang_vel0);
-            preintegration_last_frame->Append(tstep, acc, ang_vel, acc0, ang_vel0);
-        }
-
         if (Imu::Get()->initialized)
         {
             current_frame->good_imu = true;
@@ -0,0 +1,83 @@
+#include "lvio_fusion/visual/grid.h"
+
+namespace lvio_fusion
+{
+
+// hamming distance of 256 bits, compiled to POPCNT if available
+inline int hamming(const uint64_t *a, const uint64_t *b)
+{
+    return __builtin_popcountll(a[0] ^ b[0]) + __builtin_popcountll(a[1] ^ b[1]) +
+           __builtin_popcountll(a[2] ^ b[2]) + __builtin_popcountll(a[3] ^ b[3]);
+}
+
+void FeatureGrid::Build(const std::vector<visual::Feature::Ptr> &features, const cv::Mat &descriptors, cv::Size size, float cell_size)
+{
+    inv_cell_size_ = 1 / cell_size;
+    cols_ = std::max(1, (int)std::ceil(size.width * inv_cell_size_));
+    rows_ = std::max(1, (int)std::ceil(size.height * inv_cell_size_));
+
+    // counting sort by cells
+    const int n = features.size();
+    std::vector<int> cells(n);
+    cell_begin_.assign(cols_ * rows_ + 1, 0);
+    for (int i = 0; i < n; i++)
+    {
+        const cv::Point2f &pt = features[i]->keypoint.pt;
+        cells[i] = CellY(pt.y) * cols_ + CellX(pt.x);
+        cell_begin_[cells[i] + 1]++;
+    }
+    for (int i = 0; i < cols_ * rows_; i++)
+    {
+        cell_begin_[i + 1] += cell_begin_[i];
+    }
+
+    features_.resize(n);
+    xs_.resize(n);
+    ys_.resize(n);
+    angles_.resize(n);
+    descriptors_.resize(4 * n);
+    std::vector<int> next(cell_begin_.begin(), cell_begin_.end() - 1);
+    for (int i = 0; i < n; i++)
+    {
+        int j = next[cells[i]]++;
+        features_[j] = features[i];
+        xs_[j] = features[i]->keypoint.pt.x;
+        ys_[j] = features[i]->keypoint.pt.y;
+        angles_[j] = features[i]->keypoint.angle;
+        memcpy(&descriptors_[4 * j], descriptors.ptr(features[i]->descriptor), 32);
+    }
+}
+
+void FeatureGrid::Search(cv::Point2f pt, float radius, float angle, float max_rotate,
+                         const uint64_t *descriptor, HammingMatch &match) const
+{
+    if (features_.empty())
+        return;
+
+    const int x0 = CellX(pt.x - radius), x1 = CellX(pt.x + radius);
+    const int y0 = CellY(pt.y - radius), y1 = CellY(pt.y + radius);
+    const float radius2 = radius * radius;
+    for (int y = y0; y <= y1; y++)
+    {
+        for (int j = cell_begin_[y * cols_ + x0], end = cell_begin_[y * cols_ + x1 + 1]; j < end; j++)
+        {
+            float dx = xs_[j] - pt.x, dy = ys_[j] - pt.y;
+            if (std::abs(angles_[j] - angle) >= max_rotate || dx * dx + dy * dy >= radius2)
+                continue;
+
+            int distance = hamming(&descriptors_[4 * j], descriptor);
+            if (distance < match.best)
+            {
+                match.second = match.best;
+                match.best = distance;
+                match.feature = &features_[j];
+            }
+            else if (distance < match.second)
+            {
+                match.second = distance;
+            }
+        }
+    }
+}
+
+} // namespace lvio_fusion
@@ -0,0 +1,88 @@
+#include "lvio_fusion/imu/imu_buffer.h"
+
+namespace lvio_fusion
+{
+
+inline bool push(ImuData *buffer, size_t capacity, std::atomic<size_t> &head, std::atomic<size_t> &tail,
+                 double &last_time, const ImuData &data)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == capacity || data.t <= last_time)
+        return false;
+    buffer[t % capacity] = data;
+    last_time = data.t;
+    tail.store(t + 1);
+    return true;
+}
+
+bool ImuBuffer::Push(const ImuData &data)
+{
+    bool success = push(buffer_, capacity_, head_, tail_, last_time_, data);
+    if (success && waiting_.load())
+    {
+        // the consumer may sleep between checking and waiting
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_one();
+    }
+    return success;
+}
+
+int ImuBuffer::Push(const std::vector<ImuData> &data)
+{
+    int n = 0;
+    for (auto &item : data)
+    {
+        n += push(buffer_, capacity_, head_, tail_, last_time_, item);
+    }
+    if (n && waiting_.load())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_one();
+    }
+    return n;
+}
+
+size_t ImuBuffer::LowerBound(size_t head, size_t tail, double time) const
+{
+    while (head < tail)
+    {
+        size_t mid = head + (tail - head) / 2;
+        if (buffer_[mid % capacity_].t < time)
+            head = mid + 1;
+        else
+            tail = mid;
+    }
+    return head;
+}
+
+void ImuBuffer::Pop(double start, double end, double timeout, std::vector<ImuData> &out)
+{
+    out.clear();
+    auto ready = [this] {
+        return tail_.load() != head_.load(std::memory_order_relaxed);
+    };
+    if (!ready())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting_.store(true);
+        cond_.wait_for(lock, std::chrono::duration<double>(timeout), ready);
+        waiting_.store(false);
+    }
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t begin = LowerBound(head, tail, start - epsilon);
+    size_t last = LowerBound(begin, tail, end - epsilon);
+    out.reserve(last - begin + 1);
+    for (size_t i = begin; i < last; i++)
+    {
+        out.push_back(buffer_[i % capacity_]);
+    }
+    if (last < tail)
+    {
+        out.push_back(buffer_[last % capacity_]);
+    }
+    head_.store(last, std::memory_order_release);
+}
+
+} // namespace lvio_fusion
@@ -1,15 +1,14 @@
 #include "lvio_fusion/imu/initializer.h"
 #include "lvio_fusion/ceres/imu_error.hpp"
 #include "lvio_fusion/imu/tools.h"
-#include "lvio_fusion/loop/pose_graph.h"
 #include "lvio_fusion/utility.h"
 
 namespace lvio_fusion
 {
 
-void Initializer::EstimateVelAndRwg(Frames frames)
+void Initializer::EstimateVelAndRwg(const FramesView &frames)
 {
-    if (!Imu::Get()->initialized)
+    if (!initialized_)
     {
         Vector3d twg = Vector3d::Zero();
         Vector3d Vw;
@@ -29,7 +28,7 @@ void Initializer::EstimateVelAndRwg(Frames frames)
 }
 
 // make sure than every frame has last_frame and preintegrate
-bool Initializer::Initialize(Frames frames, double prior_a, double prior_g)
+bool Initializer::Initialize(const FramesView &frames, double prior_a, double prior_g)
 {
     // estimate velocity and gravity direction
     EstimateVelAndRwg(frames);
@@ -40,7 +39,7 @@ bool Initializer::Initialize(Frames frames, double prior_a, double prior_g)
         if (!imu::InertialOptimization(frames, Rwg_, prior_a, prior_g))
             return false;
         Rwg_ = get_R_from_vector(Rwg_ * Vector3d::UnitZ());
-        Map::Instance().ApplyGravityRotation(Rwg_.inverse());
+        Map::Instance().ApplyGravityRotation(Rwg_.inverse(), (--frames.end())->first);
     }
 
     for (auto &pair : frames)
@@ -50,17 +49,18 @@ bool Initializer::Initialize(Frames frames, double prior_a, double prior_g)
 
     // imu optimization with visual
     imu::FullBA(frames, prior_a, prior_g);
-    Imu::Get()->initialized = true;
+    initialized_ = true;
     return true;
 }
 
 // 3-step initialization
-void Initializer::Initialize(double init_time, double end_time)
+bool Initializer::Initialize(double init_time, double end_time, bool &initialized, SE3d &transform)
 {
     static double last_init_time = 0;
     bool need_init = false;
     double prior_a = 1e4, prior_g = 1e2;
-    if (Imu::Get()->initialized)
+    initialized_ = initialized;
+    if (initialized_)
     {
         double dt = last_init_time ? end_time - last_init_time : 0;
         if (dt > 5 && step == 2)
@@ -88,7 +88,7 @@ void Initializer::Initialize(double init_time, double end_time)
         }
     }
 
-    Frames frames_init;
+    FramesView frames_init;
     SE3d old_pose, new_pose;
     if (need_init)
     {
@@ -98,7 +98,7 @@ void Initializer::Initialize(double init_time, double end_time)
             frames_init.begin()->second->preintegration)
         {
             old_pose = (--frames_init.end())->second->pose;
-            if (!Imu::Get()->initialized)
+            if (!initialized_)
             {
                 last_init_time = (--frames_init.end())->second->time;
             }
@@ -111,22 +111,24 @@ void Initializer::Initialize(double init_time, double end_time)
         if (Initialize(frames_init, prior_a, prior_g))
         {
             new_pose = (--frames_init.end())->second->pose;
-            SE3d transform = new_pose * old_pose.inverse();
-            PoseGraph::Instance().ForwardUpdate(transform, end_time, false);
+            transform = new_pose * old_pose.inverse();
             for (auto &pair : frames_init)
             {
                 if (pair.second->preintegration)
                     pair.second->good_imu = true;
             }
             LOG(INFO) << "Initializer Finished";
+            initialized = initialized_;
+            return true;
         }
         else
         {
             step = step != 4 ? 1 : 4;
-            Imu::Get()->initialized = false;
+            initialized = initialized_ = false;
             LOG(INFO) << "Initializer Failed";
         }
     }
+    return false;
 }
 
 } // namespace lvio_fusion
@@ -0,0 +1,178 @@
+#include "lvio_fusion/imu/integrator.h"
+
+namespace lvio_fusion
+{
+
+namespace imu
+{
+
+inline Preintegration::Ptr clone(const Preintegration::Ptr &preintegration)
+{
+    return Preintegration::Ptr(new Preintegration(*preintegration));
+}
+
+// imu data at time t, interpolated linearly
+inline ImuData interpolate(const ImuData &data0, const ImuData &data1, double t)
+{
+    double k = (t - data0.t) / (data1.t - data0.t);
+    return ImuData(data0.a + (data1.a - data0.a) * k, data0.w + (data1.w - data0.w) * k, t);
+}
+
+// append the step from data0 to data1 to the preintegrations
+inline void append(std::initializer_list<Preintegration *> preintegrations, const ImuData &data0, const ImuData &data1)
+{
+    for (auto preintegration : preintegrations)
+    {
+        if (preintegration)
+        {
+            preintegration->Append(data1.t - data0.t, data1.a, data1.w, data0.a, data0.w);
+        }
+    }
+}
+
+Integrator::Integrator() : allowed_start_(std::numeric_limits<double>::max())
+{
+    thread_ = std::thread(std::bind(&Integrator::IntegratorLoop, this));
+}
+
+Integrator::~Integrator()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_all();
+    }
+    thread_.join();
+}
+
+void Integrator::AddFrame(double time)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    frames_.push_back(time);
+    cond_.notify_all();
+}
+
+void Integrator::IntegratorLoop()
+{
+    std::vector<ImuData> data;
+    while (true)
+    {
+        double start, end;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] {
+                return !running_ || (frames_.size() >= 2 && frames_[0] <= allowed_start_ + epsilon &&
+                                     !(progress_.start == frames_[0] && progress_.complete));
+            });
+            if (!running_)
+                return;
+            start = frames_[0];
+            end = frames_[1];
+            if (progress_.start != start)
+            {
+                // start the next preintegration
+                progress_ = Progress();
+                progress_.start = start;
+                progress_.end = end;
+                progress_.last = Preintegration::Create(bias_);
+            }
+        }
+
+        // data are appended as soon as they arrive
+        buffer_.Pop(start, end, 0.1, data);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        // the frontend has skipped the frame
+        if (frames_.empty() || frames_[0] != start || progress_.start != start)
+            continue;
+        for (auto &item : data)
+        {
+            if (item.t < end - epsilon)
+            {
+                Append(item);
+            }
+            else
+            {
+                progress_.next = item;
+                progress_.complete = true;
+                cond_.notify_all();
+            }
+        }
+    }
+}
+
+void Integrator::Append(const ImuData &data)
+{
+    if (progress_.n == 1)
+    {
+        // the first step starts at the frame
+        append({progress_.last.get(), keyframe_.get()}, interpolate(progress_.previous, data, progress_.start), data);
+    }
+    else if (progress_.n > 1)
+    {
+        append({progress_.last.get(), keyframe_.get()}, progress_.previous, data);
+    }
+    progress_.previous = data;
+    progress_.n++;
+}
+
+bool Integrator::Take(double time, const Bias &bias, bool restart, double timeout,
+                      Preintegration::Ptr &preintegration_last, Preintegration::Ptr &preintegration)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // drop frames skipped by the frontend, the preintegration from the last keyframe misses them
+    while (frames_.size() >= 2 && frames_[1] < time - epsilon)
+    {
+        frames_.pop_front();
+        keyframe_ = nullptr;
+    }
+    if (frames_.size() && frames_[0] < time - epsilon)
+    {
+        allowed_start_ = frames_[0];
+        bias_ = bias;
+    }
+    cond_.notify_all();
+
+    Preintegration::Ptr last;
+    if (cond_.wait_for(lock, std::chrono::duration<double>(timeout), [this, time] {
+            return frames_.size() && progress_.start == frames_[0] && progress_.complete && progress_.end >= time - epsilon;
+        }))
+    {
+        // if n is smaller than 3, initialize again.
+        if (progress_.n >= 3)
+        {
+            // the last step ends at the frame
+            last = progress_.last;
+            append({last.get(), keyframe_.get()}, progress_.previous, interpolate(progress_.previous, progress_.next, progress_.end));
+        }
+        progress_ = Progress();
+        frames_.pop_front();
+        // start the next preintegration
+        allowed_start_ = time;
+        bias_ = bias;
+        cond_.notify_all();
+    }
+
+    if (last &&
+        (last->linearized_ba != bias.linearized_ba || last->linearized_bg != bias.linearized_bg))
+    {
+        // bias has been updated by the backend
+        last->Repropagate(bias.linearized_ba, bias.linearized_bg);
+    }
+    if (!last)
+    {
+        keyframe_ = nullptr;
+    }
+    else if (restart || !keyframe_)
+    {
+        keyframe_ = clone(last);
+    }
+    // the frontend and the backend get copies, which the integrator never touches again
+    preintegration_last = last;
+    preintegration = keyframe_ ? clone(keyframe_) : nullptr;
+    return last != nullptr;
+}
+
+} // namespace imu
+
+} // namespace lvio_fusion
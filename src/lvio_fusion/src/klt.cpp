@@ -0,0 +1,318 @@
+#include "lvio_fusion/visual/klt.h"
+#include "lvio_fusion/utility.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lvio_fusion
+{
+
+// fixed point bilinear interpolation, images are scaled by 32
+const int W_BITS = 14;
+const float FLT_SCALE = 1.f / (1 << 20);
+const float min_eig_threshold = 1e-4;
+
+inline void bilinear_weights(float x, float y, int ix, int iy, int iw[4])
+{
+    float a = x - ix, b = y - iy;
+    iw[0] = cvRound((1.f - a) * (1.f - b) * (1 << W_BITS));
+    iw[1] = cvRound(a * (1.f - b) * (1 << W_BITS));
+    iw[2] = cvRound((1.f - a) * b * (1 << W_BITS));
+    iw[3] = (1 << W_BITS) - iw[0] - iw[1] - iw[2];
+}
+
+#if defined(__SSE2__)
+inline __m128i interpolate8(const uchar *src, int step, __m128i qw0, __m128i qw1)
+{
+    const __m128i z = _mm_setzero_si128(), qdelta = _mm_set1_epi32(1 << (W_BITS - 5 - 1));
+    __m128i v00 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src)), z);
+    __m128i v01 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + 1)), z);
+    __m128i v10 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + step)), z);
+    __m128i v11 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + step + 1)), z);
+    __m128i t0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v00, v01), qw0), _mm_madd_epi16(_mm_unpacklo_epi16(v10, v11), qw1));
+    __m128i t1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(v00, v01), qw0), _mm_madd_epi16(_mm_unpackhi_epi16(v10, v11), qw1));
+    t0 = _mm_srai_epi32(_mm_add_epi32(t0, qdelta), W_BITS - 5);
+    t1 = _mm_srai_epi32(_mm_add_epi32(t1, qdelta), W_BITS - 5);
+    return _mm_packs_epi32(t0, t1);
+}
+
+// gradients of 4 pixels, src is interleaved dx and dy
+inline void interpolate_gradient4(const short *src, int step, __m128i qw0, __m128i qw1, __m128i &dx, __m128i &dy)
+{
+    const __m128i qdelta = _mm_set1_epi32(1 << (W_BITS - 1));
+    __m128i v00 = _mm_loadu_si128((const __m128i *)(src));
+    __m128i v01 = _mm_loadu_si128((const __m128i *)(src + 2));
+    __m128i v10 = _mm_loadu_si128((const __m128i *)(src + step));
+    __m128i v11 = _mm_loadu_si128((const __m128i *)(src + step + 2));
+    __m128i t0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v00, v01), qw0), _mm_madd_epi16(_mm_unpacklo_epi16(v10, v11), qw1));
+    __m128i t1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(v00, v01), qw0), _mm_madd_epi16(_mm_unpackhi_epi16(v10, v11), qw1));
+    t0 = _mm_srai_epi32(_mm_add_epi32(t0, qdelta), W_BITS);
+    t1 = _mm_srai_epi32(_mm_add_epi32(t1, qdelta), W_BITS);
+    // dx0 dy0 dx1 dy1 -> dx0 dx1 dy0 dy1
+    t0 = _mm_shuffle_epi32(t0, _MM_SHUFFLE(3, 1, 2, 0));
+    t1 = _mm_shuffle_epi32(t1, _MM_SHUFFLE(3, 1, 2, 0));
+    dx = _mm_unpacklo_epi64(t0, t1);
+    dy = _mm_unpackhi_epi64(t0, t1);
+}
+
+inline int sum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+#endif
+
+inline int interpolate(const uchar *src, int step, const int iw[4])
+{
+    return (src[0] * iw[0] + src[1] * iw[1] + src[step] * iw[2] + src[step + 1] * iw[3] + (1 << (W_BITS - 5 - 1))) >> (W_BITS - 5);
+}
+
+// rows of the template are padded to a multiple of 8 with zero gradients,
+// so that the iterations are done by SSE only, without a scalar tail.
+inline int klt_stride(int size)
+{
+    return (size + 7) & ~7;
+}
+
+/**
+ * track a point on one level, points are the left top corners of the windows
+ * @param I         prev image, step is in bytes
+ * @param dI        gradients of prev image, interleaved dx and dy, step is in elements
+ * @param J         next image
+ * @param size      size of the window
+ * @param buffer    buffer of 3 * size * klt_stride(size)
+ * @return          false if the point is lost
+ */
+inline bool klt_track_level(const uchar *I, int I_step, const short *dI, int dI_step, int cols, int rows,
+                            const uchar *J, int J_step, int size, float prev_x, float prev_y,
+                            float &next_x, float &next_y, int max_iterations, float epsilon2, short *buffer)
+{
+    // the padding of a row is read too, it must stay in the border of the image
+    const int stride = klt_stride(size);
+    int ix = cvFloor(prev_x), iy = cvFloor(prev_y);
+    if (ix < -size || ix >= cols - (stride - size) || iy < -size || iy >= rows)
+        return false;
+
+    // template and its hessian, computed only once
+    int iw[4];
+    bilinear_weights(prev_x, prev_y, ix, iy, iw);
+    short *T = buffer, *Tx = buffer + size * stride, *Ty = buffer + 2 * size * stride;
+    float A11 = 0, A12 = 0, A22 = 0;
+#if defined(__SSE2__)
+    const __m128i qt0 = _mm_set1_epi32(iw[0] + (iw[1] << 16)), qt1 = _mm_set1_epi32(iw[2] + (iw[3] << 16));
+#endif
+    for (int y = 0; y < size; y++)
+    {
+        const uchar *src = I + (iy + y) * I_step + ix;
+        const short *dsrc = dI + (iy + y) * dI_step + ix * 2;
+        short *t = T + y * stride, *tx = Tx + y * stride, *ty = Ty + y * stride;
+#if defined(__SSE2__)
+        for (int x = 0; x < stride; x += 8)
+        {
+            __m128i dx0, dy0, dx1, dy1;
+            interpolate_gradient4(dsrc + x * 2, dI_step, qt0, qt1, dx0, dy0);
+            interpolate_gradient4(dsrc + x * 2 + 8, dI_step, qt0, qt1, dx1, dy1);
+            _mm_storeu_si128((__m128i *)(t + x), interpolate8(src + x, I_step, qt0, qt1));
+            _mm_storeu_si128((__m128i *)(tx + x), _mm_packs_epi32(dx0, dx1));
+            _mm_storeu_si128((__m128i *)(ty + x), _mm_packs_epi32(dy0, dy1));
+        }
+        std::fill(t + size, t + stride, 0);
+        std::fill(tx + size, tx + stride, 0);
+        std::fill(ty + size, ty + stride, 0);
+        // sums of a row fit in int
+        __m128i qa11 = _mm_setzero_si128(), qa12 = _mm_setzero_si128(), qa22 = _mm_setzero_si128();
+        for (int x = 0; x < stride; x += 8)
+        {
+            __m128i qx = _mm_loadu_si128((const __m128i *)(tx + x)), qy = _mm_loadu_si128((const __m128i *)(ty + x));
+            qa11 = _mm_add_epi32(qa11, _mm_madd_epi16(qx, qx));
+            qa12 = _mm_add_epi32(qa12, _mm_madd_epi16(qx, qy));
+            qa22 = _mm_add_epi32(qa22, _mm_madd_epi16(qy, qy));
+        }
+        A11 += (float)sum_epi32(qa11);
+        A12 += (float)sum_epi32(qa12);
+        A22 += (float)sum_epi32(qa22);
+#else
+        for (int x = 0; x < size; x++, src++, dsrc += 2)
+        {
+            t[x] = (short)interpolate(src, I_step, iw);
+            int dx = (dsrc[0] * iw[0] + dsrc[2] * iw[1] + dsrc[dI_step] * iw[2] + dsrc[dI_step + 2] * iw[3] + (1 << (W_BITS - 1))) >> W_BITS;
+            int dy = (dsrc[1] * iw[0] + dsrc[3] * iw[1] + dsrc[dI_step + 1] * iw[2] + dsrc[dI_step + 3] * iw[3] + (1 << (W_BITS - 1))) >> W_BITS;
+            tx[x] = (short)dx;
+            ty[x] = (short)dy;
+            A11 += (float)(dx * dx);
+            A12 += (float)(dx * dy);
+            A22 += (float)(dy * dy);
+        }
+#endif
+    }
+    A11 *= FLT_SCALE;
+    A12 *= FLT_SCALE;
+    A22 *= FLT_SCALE;
+    float D = A11 * A22 - A12 * A12;
+    float min_eig = (A22 + A11 - std::sqrt((A11 - A22) * (A11 - A22) + 4.f * A12 * A12)) / (2 * size * size);
+    if (min_eig < min_eig_threshold || D < FLT_EPSILON)
+        return false;
+    D = 1.f / D;
+
+    // iterate on the next image
+    float prev_dx = 0, prev_dy = 0;
+    for (int j = 0; j < max_iterations; j++)
+    {
+        int jx = cvFloor(next_x), jy = cvFloor(next_y);
+        if (jx < -size || jx >= cols - (stride - size) || jy < -size || jy >= rows)
+            return false;
+
+        bilinear_weights(next_x, next_y, jx, jy, iw);
+        float b1 = 0, b2 = 0;
+#if defined(__SSE2__)
+        const __m128i qw0 = _mm_set1_epi32(iw[0] + (iw[1] << 16)), qw1 = _mm_set1_epi32(iw[2] + (iw[3] << 16));
+#endif
+        for (int y = 0; y < size; y++)
+        {
+            const uchar *src = J + (jy + y) * J_step + jx;
+            const short *t = T + y * stride, *tx = Tx + y * stride, *ty = Ty + y * stride;
+            int x = 0, ib1 = 0, ib2 = 0;
+#if defined(__SSE2__)
+            __m128i qb1 = _mm_setzero_si128(), qb2 = _mm_setzero_si128();
+            for (; x < stride; x += 8)
+            {
+                __m128i diff = _mm_subs_epi16(interpolate8(src + x, J_step, qw0, qw1), _mm_loadu_si128((const __m128i *)(t + x)));
+                qb1 = _mm_add_epi32(qb1, _mm_madd_epi16(diff, _mm_loadu_si128((const __m128i *)(tx + x))));
+                qb2 = _mm_add_epi32(qb2, _mm_madd_epi16(diff, _mm_loadu_si128((const __m128i *)(ty + x))));
+            }
+            ib1 = sum_epi32(qb1);
+            ib2 = sum_epi32(qb2);
+#endif
+            for (; x < size; x++)
+            {
+                int diff = interpolate(src + x, J_step, iw) - t[x];
+                ib1 += diff * tx[x];
+                ib2 += diff * ty[x];
+            }
+            b1 += (float)ib1;
+            b2 += (float)ib2;
+        }
+        b1 *= FLT_SCALE;
+        b2 *= FLT_SCALE;
+
+        float dx = (A12 * b2 - A22 * b1) * D;
+        float dy = (A12 * b1 - A11 * b2) * D;
+        next_x += dx;
+        next_y += dy;
+        if (dx * dx + dy * dy <= epsilon2)
+            break;
+
+        // oscillation
+        if (j > 0 && std::abs(dx + prev_dx) < 0.01 && std::abs(dy + prev_dy) < 0.01)
+        {
+            next_x -= dx * 0.5f;
+            next_y -= dy * 0.5f;
+            break;
+        }
+        prev_dx = dx;
+        prev_dy = dy;
+    }
+    return true;
+}
+
+KLT::KLT(int half_window, int max_level, int max_iterations, float epsilon)
+    : half_window(half_window), max_level(max_level), max_iterations(max_iterations), epsilon(epsilon)
+{
+}
+
+KLT KLT::Adapt(double motion)
+{
+    // the error of prediction is about 2 + 0.5 * motion,
+    // small motions are covered by a 15x15 window on two levels, larger ones on three.
+    if (motion < 10)
+        return KLT(7, 1);
+    if (motion < 25)
+        return KLT(7, 2);
+    // otherwise the same as optical_flow()
+    return KLT();
+}
+
+void KLT::TrackForward(const std::vector<cv::Mat> &prev_pyramid, const std::vector<cv::Mat> &next_pyramid,
+                       const std::vector<cv::Point2f> &prev_pts, std::vector<cv::Point2f> &next_pts,
+                       std::vector<uchar> &status) const
+{
+    const int n = prev_pts.size();
+    status.assign(n, 1);
+    if (n == 0)
+        return;
+
+    // pyramids have gradients
+    assert(prev_pyramid.size() >= 2 && prev_pyramid[1].type() == CV_16SC2);
+    assert(next_pyramid.size() >= 2 && next_pyramid[1].type() == CV_16SC2);
+    const int levels = std::min(max_level, (int)std::min(prev_pyramid.size(), next_pyramid.size()) / 2 - 1);
+    const int size = 2 * half_window + 1;
+    const float epsilon2 = epsilon * epsilon;
+
+    // each batch of points shares one buffer
+    const int batch = 64;
+    parallel_for((n + batch - 1) / batch, [&](int k) {
+        std::vector<short> buffer(3 * size * klt_stride(size));
+        for (int i = k * batch; i < std::min(n, (k + 1) * batch); i++)
+        {
+            float next_x = 0, next_y = 0;
+            for (int level = levels; level >= 0; level--)
+            {
+                const cv::Mat &I = prev_pyramid[level * 2], &dI = prev_pyramid[level * 2 + 1], &J = next_pyramid[level * 2];
+                float scale = 1.f / (1 << level);
+                if (level == levels)
+                {
+                    next_x = next_pts[i].x * scale;
+                    next_y = next_pts[i].y * scale;
+                }
+                else
+                {
+                    next_x *= 2;
+                    next_y *= 2;
+                }
+
+                next_x -= half_window;
+                next_y -= half_window;
+                bool success = klt_track_level(I.ptr<uchar>(), (int)I.step, dI.ptr<short>(), (int)dI.step1(), I.cols, I.rows,
+                                               J.ptr<uchar>(), (int)J.step, size,
+                                               prev_pts[i].x * scale - half_window, prev_pts[i].y * scale - half_window,
+                                               next_x, next_y, max_iterations, epsilon2, buffer.data());
+                next_x += half_window;
+                next_y += half_window;
+                if (!success && level == 0)
+                {
+                    status[i] = 0;
+                }
+            }
+            next_pts[i] = cv::Point2f(next_x, next_y);
+        }
+    });
+}
+
+void KLT::Track(const std::vector<cv::Mat> &prev_pyramid, const std::vector<cv::Mat> &next_pyramid,
+                const std::vector<cv::Point2f> &prev_pts, std::vector<cv::Point2f> &next_pts,
+                std::vector<uchar> &status) const
+{
+    if (prev_pts.empty())
+        return;
+
+    TrackForward(prev_pyramid, next_pyramid, prev_pts, next_pts, status);
+
+    // a small window is enough for tracking back
+    std::vector<uchar> reverse_status;
+    std::vector<cv::Point2f> reverse_pts = prev_pts;
+    KLT(1, 1, max_iterations, epsilon).TrackForward(next_pyramid, prev_pyramid, next_pts, reverse_pts, reverse_status);
+
+    const cv::Size size = prev_pyramid[0].size();
+    for (int i = 0; i < status.size(); i++)
+    {
+        cv::Point2f reverse_pt = reverse_pts[i], prev_pt = prev_pts[i];
+        status[i] = status[i] && reverse_status[i] &&
+                    cv_distance(prev_pt, reverse_pt) <= 0.5 &&
+                    next_pts[i].x >= 0 && next_pts[i].x < size.width &&
+                    next_pts[i].y >= 0 && next_pts[i].y < size.height;
+    }
+}
+
+} // namespace lvio_fusion
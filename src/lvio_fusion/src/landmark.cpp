@@ -20,7 +20,7 @@ Vector3d Landmark::ToWorld()
 
 visual::Landmark::Ptr Landmark::Create(double inv_depth)
 {
-    visual::Landmark::Ptr new_point(new Landmark);
+    visual::Landmark::Ptr new_point = HandleStore<Landmark>::Create();
     new_point->inv_depth = inv_depth;
     return new_point;
 }
@@ -36,7 +36,7 @@ void Landmark::Clear()
     right_feature->frame.lock()->features_right.erase(id);
 
     int num = 0;
-    Frames a = Map::Instance().GetKeyFrames(FirstFrame().lock()->time);
+    FramesView a = Map::Instance().GetKeyFrames(FirstFrame().lock()->time);
     for (auto &i : a)
     {
         if (i.second->features_left.find(id) != i.second->features_left.end())
@@ -47,9 +47,9 @@ void Landmark::Clear()
     assert(num == 0);
 }
 
-std::weak_ptr<Frame> Landmark::FirstFrame()
+const std::weak_ptr<Frame> &Landmark::FirstFrame()
 {
-    auto frame = first_observation->frame;
+    auto &frame = first_observation->frame;
     assert(!frame.expired());
     return frame;
 }
@@ -66,7 +66,7 @@ void Landmark::AddObservation(visual::Feature::Ptr feature)
     assert(feature->landmark.lock()->id == id);
     if (feature->is_on_left_image)
     {
-        observations[feature->frame.lock()->id] = feature;
+        observations.insert_or_assign(feature->frame.lock()->id, feature);
     }
     else
     {
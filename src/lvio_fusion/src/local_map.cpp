@@ -3,47 +3,16 @@
 #include "lvio_fusion/map.h"
 #include "lvio_fusion/utility.h"
 #include "lvio_fusion/visual/camera.h"
+#include "lvio_fusion/visual/painter.h"
 
 namespace lvio_fusion
 {
 
-inline cv::Mat brief2mat(BRIEF &brief)
-{
-    return cv::Mat(1, 32, CV_8U, reinterpret_cast<uchar *>(&brief));
-}
-
-inline BRIEF mat2brief(const cv::Mat &mat)
-{
-    BRIEF brief;
-    memcpy(&brief, mat.data, 32);
-    return brief;
-}
-
-inline std::vector<BRIEF> mat2briefs(cv::Mat descriptors)
-{
-    std::vector<BRIEF> briefs;
-    for (int i = 0; i < descriptors.rows; i++)
-    {
-        briefs.push_back(mat2brief(descriptors.row(i)));
-    }
-    return briefs;
-}
-
-inline cv::Mat briefs2mat(std::vector<BRIEF> briefs)
-{
-    cv::Mat descriptors(briefs.size(), 32, CV_8U);
-    for (int i = 0; i < briefs.size(); i++)
-    {
-        brief2mat(briefs[i]).copyTo(descriptors.row(i));
-    }
-    return descriptors;
-}
-
 inline Vector3d LocalMap::ToWorld(visual::Feature::Ptr feature)
 {
     Vector3d pb = Camera::Get(1)->Pixel2Robot(
-        cv2eigen(feature->landmark.lock()->first_observation->keypoint.pt),
-        1 / feature->landmark.lock()->inv_depth);
+        cv2eigen(feature->landmark.get()->first_observation->keypoint.pt),
+        1 / feature->landmark.get()->inv_depth);
     return Camera::Get()->Robot2World(pb, pose_cache[feature->frame.lock()->time]);
 }
 
@@ -65,6 +34,7 @@ void LocalMap::Reset()
 {
     std::unique_lock<std::mutex> lock(mutex_);
     local_features_.clear();
+    local_grids_.clear();
     landmarks.clear();
     position_cache.clear();
     pose_cache.clear();
@@ -111,10 +81,12 @@ void LocalMap::AddKeyFrame(Frame::Ptr new_kf)
             }
         }
         local_features_.erase(local_features_.begin());
+        local_grids_.erase(local_grids_.begin());
     }
 }
 
-void LocalMap::UpdateCache()
+void LocalMap::UpdateCache(const std::unordered_map<double, SE3d> &poses,
+                           const std::unordered_map<unsigned long, Vector3d> &positions)
 {
     std::unique_lock<std::mutex> lock(mutex_);
     pose_cache.clear();
@@ -122,12 +94,14 @@ void LocalMap::UpdateCache()
 
     for (auto &pair : local_features_)
     {
-        pose_cache[pair.first] = Map::Instance().GetKeyFrame(pair.first)->pose;
+        auto iter = poses.find(pair.first);
+        pose_cache[pair.first] = iter != poses.end() ? iter->second : Map::Instance().GetKeyFrame(pair.first)->pose;
     }
 
     for (auto &pair : landmarks)
     {
-        position_cache[pair.first] = pair.second->ToWorld();
+        auto iter = positions.find(pair.first);
+        position_cache[pair.first] = iter != positions.end() ? iter->second : pair.second->ToWorld();
     }
 }
 
@@ -136,7 +110,7 @@ void LocalMap::GetFeaturePyramid(Frame::Ptr frame, Pyramid &pyramid)
     // we don't use a mask. new feature can overlap the old.
     // detect
     std::vector<std::vector<cv::KeyPoint>> kps;
-    extractor_.Detect(frame->image_left, kps);
+    extractor_.Detect(frame->image_left, frame->orb_pyramid, kps);
     // pyramid
     pyramid.clear();
     pyramid.resize(num_levels_);
@@ -227,40 +201,74 @@ void LocalMap::GetNewLandmarks(Frame::Ptr frame, Pyramid &pyramid)
             keypoints[i].push_back(feature->keypoint);
         }
     }
-    cv::Mat descriptors = extractor_.Compute(keypoints);
+    frame->descriptors = extractor_.Compute(frame->orb_pyramid, keypoints);
 
     for (int i = 0, j = 0; i < num_levels_; i++)
     {
         for (auto &feature : pyramid[i])
         {
-            feature->brief = mat2brief(descriptors.row(j++));
+            feature->descriptor = j++;
         }
     }
+
+    // index features for searching
+    Grids &grids = local_grids_[frame->time];
+    grids.resize(num_levels_);
+    for (int i = 0; i < num_levels_; i++)
+    {
+        grids[i].Build(pyramid[i], frame->descriptors, frame->image_left.size(), extractor_.patch_size * scale_factors_[i]);
+    }
 }
 
 void LocalMap::Triangulate(Frame::Ptr frame, Level &features)
 {
     std::vector<cv::Point2f> kps_left, kps_right;
+    std::vector<Vector3d> pbs;
+    std::vector<uchar> status;
     kps_left.resize(features.size());
     for (int i = 0; i < features.size(); i++)
     {
         kps_left[i] = features[i]->keypoint.pt;
-        auto pb = Camera::Get()->Pixel2Robot(cv2eigen(kps_left[i]), Camera::baseline * 50);
-        auto pixel = eigen2cv(Camera::Get(1)->Robot2Pixel(pb));
-        kps_right.push_back(pixel);
     }
-    std::vector<uchar> status;
-    optical_flow(frame->image_left, frame->image_right, kps_left, kps_right, status);
+    if (stereo_matcher_)
+    {
+        stereo_matcher_->Match(frame->image_left, frame->GetImageRight(), kps_left, kps_right, pbs, status);
+    }
+    else
+    {
+        for (int i = 0; i < features.size(); i++)
+        {
+            auto pb = Camera::Get()->Pixel2Robot(cv2eigen(kps_left[i]), Camera::baseline * 50);
+            auto pixel = eigen2cv(Camera::Get(1)->Robot2Pixel(pb));
+            kps_right.push_back(pixel);
+        }
+        optical_flow(frame->GetPyramidLeft(), frame->GetPyramidRight(), kps_left, kps_right, status);
+
+        // triangulation in batch
+        const int n = kps_left.size();
+        ArrayXd x0(n), y0(n), x1(n), y1(n), depths;
+        for (int i = 0; i < n; i++)
+        {
+            Vector3d p0 = Camera::Get()->Pixel2Sensor(cv2eigen(kps_left[i]));
+            Vector3d p1 = Camera::Get(1)->Pixel2Sensor(cv2eigen(kps_right[i]));
+            x0[i] = p0.x();
+            y0[i] = p0.y();
+            x1[i] = p1.x();
+            y1[i] = p1.y();
+        }
+        triangulate(Camera::Get()->extrinsic.inverse(), Camera::Get(1)->extrinsic.inverse(), x0, y0, x1, y1, depths);
+        pbs.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            pbs[i] = Camera::Get()->Sensor2Robot(Vector3d(x0[i], y0[i], 1) * depths[i]);
+        }
+    }
     // triangulate new points
     for (int i = 0; i < kps_left.size(); ++i)
     {
         if (status[i])
         {
-            // triangulation
-            Vector2d kp_left = cv2eigen(kps_left[i]);
-            Vector2d kp_right = cv2eigen(kps_right[i]);
-            Vector3d pb = Vector3d::Zero();
-            triangulate(Camera::Get()->extrinsic.inverse(), Camera::Get(1)->extrinsic.inverse(), Camera::Get()->Pixel2Sensor(kp_left), Camera::Get(1)->Pixel2Sensor(kp_right), pb);
+            Vector3d pb = pbs[i];
             if (Camera::Get()->Robot2Sensor(pb).z() > 0)
             {
                 if (features[i]->landmark.expired())
@@ -283,7 +291,7 @@ void LocalMap::Triangulate(Frame::Ptr frame, Level &features)
                     if (e / dt > 4 || e > 2)
                     {
                         frame->RemoveFeature(features[i]);
-                        cv::putText(img_track, "X", kps_left[i], cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 255));
+                        Painter::Instance().Cross(kps_left[i], cv::Scalar(0, 0, 255));
                     }
                 }
             }
@@ -314,11 +322,11 @@ void LocalMap::Search(std::vector<double> kfs, Frame::Ptr frame)
 {
     for (int i = 0; i < kfs.size(); i++)
     {
-        Search(local_features_[kfs[i]], pose_cache[kfs[i]], local_features_[frame->time], frame);
+        Search(local_grids_[kfs[i]], pose_cache[kfs[i]], local_features_[frame->time], frame);
     }
 }
 
-void LocalMap::Search(Pyramid &last_pyramid, SE3d last_pose, Pyramid &current_pyramid, Frame::Ptr frame)
+void LocalMap::Search(const Grids &last_grids, SE3d last_pose, Pyramid &current_pyramid, Frame::Ptr frame)
 {
     for (auto &features : current_pyramid)
     {
@@ -326,49 +334,35 @@ void LocalMap::Search(Pyramid &last_pyramid, SE3d last_pose, Pyramid &current_py
         {
             if (!feature->match)
             {
-                Search(last_pyramid, last_pose, feature, frame);
+                Search(last_grids, last_pose, feature, frame);
             }
         }
     }
 }
 
-void LocalMap::Search(Pyramid &last_pyramid, SE3d last_pose, visual::Feature::Ptr feature, Frame::Ptr frame)
+void LocalMap::Search(const Grids &last_grids, SE3d last_pose, visual::Feature::Ptr feature, Frame::Ptr frame)
 {
     auto pc = Camera::Get()->World2Sensor(position_cache[feature->landmark.lock()->id], last_pose);
     if (pc.z() < 0)
         return;
     cv::Point2f p_in_last_left = eigen2cv(Camera::Get()->Sensor2Pixel(pc));
-    Level features_in_radius;
-    std::vector<BRIEF> briefs;
+    const uint64_t *descriptor = frame->descriptors.ptr<uint64_t>(feature->descriptor);
+    HammingMatch match;
     //TODO: check if forward or backward
     int min_level = feature->keypoint.octave, max_level = feature->keypoint.octave + 1;
     for (int i = min_level; i <= max_level && i < num_levels_; i++)
     {
         double radius = extractor_.patch_size * scale_factors_[i];
-        for (auto &last_feature : last_pyramid[i])
-        {
-            double rotate = std::abs(last_feature->keypoint.angle - feature->keypoint.angle);
-            if (rotate < 15)
-            {
-                if (cv_distance(p_in_last_left, last_feature->keypoint.pt) < radius)
-                {
-                    features_in_radius.push_back(last_feature);
-                    briefs.push_back(last_feature->brief);
-                }
-            }
-        }
+        last_grids[i].Search(p_in_last_left, radius, feature->keypoint.angle, 15, descriptor, match);
     }
 
-    cv::Mat descriptors_last = briefs2mat(briefs), descriptors_current = brief2mat(feature->brief);
-    std::vector<std::vector<cv::DMatch>> knn_matches;
-    matcher_->knnMatch(descriptors_current, descriptors_last, knn_matches, 2);
     const float ratio_threshold = 0.8;
     const float low_threshold = 50;
-    if (!features_in_radius.empty() && !knn_matches.empty() && knn_matches[0].size() == 2 &&
-        knn_matches[0][0].distance < low_threshold &&
-        knn_matches[0][0].distance < ratio_threshold * knn_matches[0][1].distance)
+    if (match.feature && match.second != INT_MAX &&
+        match.best < low_threshold &&
+        match.best < ratio_threshold * match.second)
     {
-        auto last_feature = features_in_radius[knn_matches[0][0].trainIdx];
+        auto last_feature = *match.feature;
 
         // add feature
         feature->match = true;
@@ -386,7 +380,7 @@ void LocalMap::Search(Pyramid &last_pyramid, SE3d last_pose, visual::Feature::Pt
             last_frame->AddFeature(last_landmark->first_observation);
             Map::Instance().InsertLandmark(last_landmark);
         }
-        cv::circle(img_track, feature->keypoint.pt, 2, cv::Scalar(255, 0, 0), cv::FILLED);
+        Painter::Instance().Circle(feature->keypoint.pt, cv::Scalar(255, 0, 0));
     }
 }
 
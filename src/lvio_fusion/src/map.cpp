@@ -8,7 +8,18 @@ void Map::InsertKeyFrame(Frame::Ptr frame)
 {
     std::unique_lock<std::mutex> lock(mutex_local_kfs);
     Frame::current_frame_id++;
-    keyframes[frame->time] = frame;
+    // keyframes arrive in time order, so a keyframe is appended to the last chunk
+    FramesView keyframes = Snapshot();
+    assert(keyframes.empty() || frame->time > (--keyframes.end())->first);
+    if (keyframes.size() % FramesIterator::chunk_size == 0)
+    {
+        auto chunks = std::make_shared<FramesChunks>(*chunks_);
+        chunks->push_back(std::make_shared<FramesChunk>());
+        chunks->back()->reserve(FramesIterator::chunk_size);
+        chunks_ = chunks;
+    }
+    chunks_->back()->emplace_back(frame->time, frame);
+    std::atomic_store(&keyframes_, std::make_shared<const FramesView>(chunks_, keyframes.size() + 1));
 }
 
 void Map::InsertLandmark(visual::Landmark::Ptr landmark)
@@ -20,6 +31,7 @@ void Map::InsertLandmark(visual::Landmark::Ptr landmark)
 // time < 0 or time > end: return the last one
 Frame::Ptr Map::GetKeyFrame(double time)
 {
+    auto keyframes = Snapshot();
     if (time < 0)
         return (--keyframes.end())->second;
     auto iter = keyframes.lower_bound(time);
@@ -46,40 +58,38 @@ Frame::Ptr Map::GetKeyFrame(double time)
 // 2: [start -> end]
 // 3: (start -> num]
 // 4: [num -> end)
-Frames Map::GetKeyFrames(double start, double end, int num)
+FramesView Map::GetKeyFrames(double start, double end, int num)
 {
+    auto keyframes = Snapshot();
     if (end == 0 && num == 0)
     {
-        auto start_iter = keyframes.lower_bound(start);
-        return start_iter == keyframes.end() ? Frames() : Frames(start_iter, keyframes.end());
+        return FramesView(keyframes, keyframes.lower_bound(start), keyframes.end());
     }
     else if (num == 0)
     {
         auto start_iter = keyframes.lower_bound(start);
         auto end_iter = keyframes.upper_bound(end);
-        return start > end ? Frames() : Frames(start_iter, end_iter);
+        return start > end ? FramesView() : FramesView(keyframes, start_iter, end_iter);
     }
     else if (end == 0)
     {
-        auto iter = keyframes.upper_bound(start);
-        Frames frames;
-        for (int i = 0; i < num && iter != keyframes.end(); i++)
+        auto begin_iter = keyframes.upper_bound(start), end_iter = begin_iter;
+        for (int i = 0; i < num && end_iter != keyframes.end(); i++)
         {
-            frames.insert(*(iter++));
+            end_iter++;
         }
-        return frames;
+        return FramesView(keyframes, begin_iter, end_iter);
     }
     else if (start == 0)
     {
-        auto iter = keyframes.lower_bound(end);
-        Frames frames;
-        for (int i = 0; i < num && iter != keyframes.begin(); i++)
+        auto end_iter = keyframes.lower_bound(end), begin_iter = end_iter;
+        for (int i = 0; i < num && begin_iter != keyframes.begin(); i++)
         {
-            frames.insert(*(--iter));
+            begin_iter--;
         }
-        return frames;
+        return FramesView(keyframes, begin_iter, end_iter);
     }
-    return Frames();
+    return FramesView();
 }
 
 void Map::RemoveLandmark(visual::Landmark::Ptr landmark)
@@ -91,6 +101,7 @@ void Map::RemoveLandmark(visual::Landmark::Ptr landmark)
 
 SE3d Map::ComputePose(double time)
 {
+    auto keyframes = Snapshot();
     auto frame1 = keyframes.lower_bound(time)->second;
     auto frame2 = keyframes.upper_bound(time)->second;
     double d_t = time - frame1->time;
@@ -101,10 +112,10 @@ SE3d Map::ComputePose(double time)
     return SE3d(q, t);
 }
 
-void Map::ApplyGravityRotation(const Matrix3d &R)
+void Map::ApplyGravityRotation(const Matrix3d &R, double end_time)
 {
     Quaterniond q(R);
-    for (auto pair : keyframes)
+    for (auto pair : GetKeyFrames(0, end_time))
     {
         Frame::Ptr frame = pair.second;
         frame->SetPose(q * frame->R(), q * frame->t());
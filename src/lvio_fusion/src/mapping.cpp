@@ -39,7 +39,7 @@ inline void Mapping::Color(const PointICloud &points_ground, const PointICloud &
 
 Frames get_lidar_frames(double start, double end, int num)
 {
-    auto keyframes = Map::Instance().keyframes;
+    auto keyframes = Map::Instance().Snapshot();
     if (end == 0)
     {
         auto iter = keyframes.upper_bound(start);
@@ -136,7 +136,7 @@ void Mapping::BuildMapFrame(Frame::Ptr frame, Frame::Ptr map_frame)
     map_frame->feature_lidar->points_ground = points_ground_merged;
 }
 
-void Mapping::Optimize(Frames &active_kfs)
+void Mapping::Optimize(const FramesView &active_kfs)
 {
     // NOTE: some place is good, don't need optimize too much.
     for (auto &pair : active_kfs)
@@ -267,8 +267,8 @@ int Mapping::Relocate(Frame::Ptr last_frame, Frame::Ptr current_frame, SE3d &rel
             ceres::Solver::Summary summary;
             ceres::Solve(options, &problem, &summary);
             clone_frame->pose = map_frame->pose * rpyxyz2se3(rpyxyz);
-            score_ground = std::min((double)summary.num_residual_blocks_reduced / 10, 20.0);
-            score_ground -= 2 * summary.final_cost / summary.num_residual_blocks_reduced;
+            score_ground = std::min((double)summary.num_residuals_reduced / 10, 20.0);
+            score_ground -= 2 * summary.final_cost / summary.num_residuals_reduced;
         }
         if (!map_frame->feature_lidar->points_surf.empty())
         {
@@ -281,8 +281,8 @@ int Mapping::Relocate(Frame::Ptr last_frame, Frame::Ptr current_frame, SE3d &rel
             ceres::Solver::Summary summary;
             ceres::Solve(options, &problem, &summary);
             clone_frame->pose = map_frame->pose * rpyxyz2se3(rpyxyz);
-            score_surf = std::min((double)summary.num_residual_blocks_reduced / 10, 30.0);
-            score_surf -= 2 * summary.final_cost / summary.num_residual_blocks_reduced;
+            score_surf = std::min((double)summary.num_residuals_reduced / 10, 30.0);
+            score_surf -= 2 * summary.final_cost / summary.num_residuals_reduced;
         }
     }
 
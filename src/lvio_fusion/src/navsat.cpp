@@ -12,7 +12,7 @@ void Navsat::AddPoint(double time, double x, double y, double z, Vector3d cov)
     raw[time] = Vector3d(x, y, z);
 
     static double finished = 0;
-    Frames new_kfs = Map::Instance().GetKeyFrames(finished);
+    FramesView new_kfs = Map::Instance().GetKeyFrames(finished);
     for (auto &pair : new_kfs)
     {
         auto this_iter = raw.lower_bound(pair.first);
@@ -28,7 +28,7 @@ void Navsat::AddPoint(double time, double x, double y, double z, Vector3d cov)
         pair.second->feature_navsat = navsat::Feature::Ptr(new navsat::Feature(pair.first, cov));
         finished = pair.first + epsilon;
     }
-    if (!initialized && !Map::Instance().keyframes.empty() && frames_distance(0, -1) > min_distance_fix_)
+    if (!initialized && Map::Instance().size() && frames_distance(0, -1) > min_distance_fix_)
     {
         Initialize();
     }
@@ -71,7 +71,7 @@ Vector3d Navsat::GetAroundPoint(double time)
 
 void Navsat::Initialize()
 {
-    Frames keyframes = Map::Instance().keyframes;
+    FramesView keyframes = Map::Instance().GetKeyFrames(0);
 
     ceres::Problem problem;
     double para[6] = {0, 0, 0, 0, 0, 0};
@@ -114,7 +114,7 @@ void Navsat::Optimize(const Section &section)
     // do not use all keyframes in BC, too much frames is not good
     OptimizeRX(B, section.C, section.C, 0b000000);
     // second, optimize B-C
-    Frames BC = Map::Instance().GetKeyFrames(section.B + epsilon, section.C - epsilon);
+    FramesView BC = Map::Instance().GetKeyFrames(section.B + epsilon, section.C - epsilon);
     for (auto &pair : BC)
     {
         auto frame = pair.second;
@@ -188,7 +188,7 @@ void Navsat::OptimizeRX(Frame::Ptr frame, double end, double forward, unsigned c
     SE3d old_pose = frame->pose;
     ceres::Problem problem;
     ceres::LossFunction *loss_function = new ceres::HuberLoss(1.0);
-    Frames active_kfs = Map::Instance().GetKeyFrames(frame->time, end);
+    FramesView active_kfs = Map::Instance().GetKeyFrames(frame->time, end);
     double para[6] = {0, 0, 0, 0, 0, 0};
     //NOTE: the real order of rpy is y p r
     problem.AddParameterBlock(para + 5, 1); //z
@@ -257,7 +257,7 @@ void Navsat::OptimizeAB(Frame::Ptr A, Frame::Ptr B, SE3d old_B)
     ceres::LocalParameterization *local_parameterization = new ceres::ProductParameterization(
         new ceres::EigenQuaternionParameterization(),
         new ceres::IdentityParameterization(3));
-    Frames AB = Map::Instance().GetKeyFrames(A->time + epsilon, B->time - epsilon);
+    FramesView AB = Map::Instance().GetKeyFrames(A->time + epsilon, B->time - epsilon);
     problem.AddParameterBlock(A->pose.data(), SE3d::num_parameters, local_parameterization);
     problem.AddParameterBlock(B->pose.data(), SE3d::num_parameters, local_parameterization);
     problem.SetParameterBlockConstant(A->pose.data());
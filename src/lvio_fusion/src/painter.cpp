@@ -0,0 +1,87 @@
+#include "lvio_fusion/visual/painter.h"
+
+#include <pthread.h>
+
+namespace lvio_fusion
+{
+
+Painter::~Painter()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void Painter::Init(bool headless)
+{
+    enabled_ = !headless;
+    if (enabled_ && !thread_.joinable())
+    {
+        running_ = true;
+        thread_ = std::thread(std::bind(&Painter::RenderLoop, this));
+        // rendering should never slow down tracking
+        sched_param param;
+        param.sched_priority = 0;
+        pthread_setschedparam(thread_.native_handle(), SCHED_IDLE, &param);
+    }
+    LOG(INFO) << "Painter " << (enabled_ ? "enabled" : "disabled (headless)");
+}
+
+void Painter::End()
+{
+    if (!enabled_)
+        return;
+    {
+        // replace the frame not rendered yet
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::swap(next_, current_);
+        pending_ = true;
+    }
+    cond_.notify_one();
+    current_.image = cv::Mat();
+}
+
+void Painter::RenderLoop()
+{
+    Canvas canvas;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return pending_ || !running_; });
+            if (!running_)
+                break;
+            std::swap(canvas, next_);
+            pending_ = false;
+        }
+
+        cv::Mat img_track;
+        cv::cvtColor(canvas.image, img_track, cv::COLOR_GRAY2RGB);
+        for (auto &record : canvas.records)
+        {
+            switch (record.type)
+            {
+            case Record::ARROW:
+                cv::arrowedLine(img_track, record.p0, record.p1, record.color, 1, 8, 0, 0.2);
+                cv::circle(img_track, record.p0, 2, record.color, cv::FILLED);
+                break;
+            case Record::CIRCLE:
+                cv::circle(img_track, record.p0, 2, record.color, cv::FILLED);
+                break;
+            case Record::CROSS:
+                cv::putText(img_track, "X", record.p0, cv::FONT_HERSHEY_SIMPLEX, 0.5, record.color);
+                break;
+            }
+        }
+        cv::imshow("tracking", img_track);
+        cv::waitKey(1);
+    }
+}
+
+} // namespace lvio_fusion
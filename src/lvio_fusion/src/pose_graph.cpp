@@ -51,7 +51,7 @@ Atlas PoseGraph::FilterOldSubmaps(double start, double end)
 
 Vector3d get_ori(std::queue<double> &buf)
 {
-    Frames frames = Map::Instance().GetKeyFrames(buf.front(), buf.back());
+    FramesView frames = Map::Instance().GetKeyFrames(buf.front(), buf.back());
     Vector3d ori(0, 0, 0);
     for (auto &pair : frames)
     {
@@ -81,7 +81,7 @@ void PoseGraph::UpdateSections(double time)
 
     if (time < finished)
         return;
-    Frames active_kfs = Map::Instance().GetKeyFrames(finished, time);
+    FramesView active_kfs = Map::Instance().GetKeyFrames(finished, time);
     finished = time + epsilon;
     for (auto &pair : active_kfs)
     {
@@ -141,7 +141,7 @@ Atlas PoseGraph::GetSections(double start, double end)
 
 Section PoseGraph::GetSection(double time)
 {
-    assert(time >= Map::Instance().keyframes.begin()->first);
+    assert(time >= Map::Instance().GetKeyFrames(0).begin()->first);
     return (--sections_.upper_bound(time))->second;
 }
 
@@ -212,14 +212,14 @@ void PoseGraph::Optimize(Atlas &sections, Section &submap, adapt::Problem &probl
         if (last_time)
         {
             SE3d transfrom = Map::Instance().GetKeyFrame(last_time)->pose * last_section.pose.inverse();
-            Frames forward_kfs = Map::Instance().GetKeyFrames(last_time + epsilon, pair.first - epsilon);
+            FramesView forward_kfs = Map::Instance().GetKeyFrames(last_time + epsilon, pair.first - epsilon);
             ForwardUpdate(transfrom, forward_kfs);
         }
         last_time = pair.first;
         last_section = pair.second;
     }
     SE3d transfrom = Map::Instance().GetKeyFrame(last_time)->pose * last_section.pose.inverse();
-    Frames forward_kfs = Map::Instance().GetKeyFrames(last_time + epsilon, submap.B - epsilon);
+    FramesView forward_kfs = Map::Instance().GetKeyFrames(last_time + epsilon, submap.B - epsilon);
     ForwardUpdate(transfrom, forward_kfs);
 }
 
@@ -231,24 +231,25 @@ void PoseGraph::ForwardUpdate(SE3d transform, double start_time, bool need_lock)
     {
         lock.lock();
     }
-    Frames forward_kfs = Map::Instance().GetKeyFrames(start_time);
-    Frame::Ptr last_frame = frontend_->last_frame;
-    if (forward_kfs.find(last_frame->time) == forward_kfs.end())
-    {
-        forward_kfs[last_frame->time] = last_frame;
-    }
-    ForwardUpdate(transform, forward_kfs);
+    // the last state of the backend comes first
+    frontend_->UpdateState();
+    ForwardUpdate(transform, Map::Instance().GetKeyFrames(start_time), frontend_->last_frame);
     frontend_->UpdateCache();
 }
 
 // new pose = transform * old pose;
-void PoseGraph::ForwardUpdate(SE3d transform, const Frames &forward_kfs)
+void PoseGraph::ForwardUpdate(SE3d transform, const FramesView &forward_kfs, Frame::Ptr last_frame)
 {
     for (auto &pair : forward_kfs)
     {
         pair.second->pose = transform * pair.second->pose;
         pair.second->Vw = transform.rotationMatrix() * pair.second->Vw;
     }
+    if (last_frame && forward_kfs.find(last_frame->time) == forward_kfs.end())
+    {
+        last_frame->pose = transform * last_frame->pose;
+        last_frame->Vw = transform.rotationMatrix() * last_frame->Vw;
+    }
 }
 
 } // namespace lvio_fusion
\ No newline at end of file
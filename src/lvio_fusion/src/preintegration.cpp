@@ -18,13 +18,8 @@ Preintegration::Preintegration(const Vector3d &_linearized_ba, const Vector3d &_
       sum_dt{0.0}, delta_p{Vector3d::Zero()}, delta_q{Quaterniond::Identity()}, delta_v{Vector3d::Zero()}
 {
     delta_bias = Matrix<double, 6, 1>::Zero();
-    noise = Matrix<double, 18, 18>::Zero();
-    noise.block<3, 3>(0, 0) = (Imu::Get()->ACC_N * Imu::Get()->ACC_N) * Matrix3d::Identity();
-    noise.block<3, 3>(3, 3) = (Imu::Get()->GYR_N * Imu::Get()->GYR_N) * Matrix3d::Identity();
-    noise.block<3, 3>(6, 6) = (Imu::Get()->ACC_N * Imu::Get()->ACC_N) * Matrix3d::Identity();
-    noise.block<3, 3>(9, 9) = (Imu::Get()->GYR_N * Imu::Get()->GYR_N) * Matrix3d::Identity();
-    noise.block<3, 3>(12, 12) = (Imu::Get()->ACC_W * Imu::Get()->ACC_W) * Matrix3d::Identity();
-    noise.block<3, 3>(15, 15) = (Imu::Get()->GYR_W * Imu::Get()->GYR_W) * Matrix3d::Identity();
+    noise << Imu::Get()->ACC_N * Imu::Get()->ACC_N, Imu::Get()->GYR_N * Imu::Get()->GYR_N,
+        Imu::Get()->ACC_W * Imu::Get()->ACC_W, Imu::Get()->GYR_W * Imu::Get()->GYR_W;
 }
 
 void Preintegration::MidPointIntegration(
@@ -63,44 +58,53 @@ void Preintegration::MidPointIntegration(
             a_1_x(2), 0, -a_1_x(0),
             -a_1_x(1), a_1_x(0), 0;
 
-        MatrixXd F = MatrixXd::Zero(15, 15);
-        F.block<3, 3>(0, 0) = Matrix3d::Identity();
-        F.block<3, 3>(0, 3) = -0.25 * delta_q.toRotationMatrix() * R_a_0_x * _dt * _dt +
-                              -0.25 * result_delta_q.toRotationMatrix() * R_a_1_x * (Matrix3d::Identity() - R_w_x * _dt) * _dt * _dt;
-        F.block<3, 3>(0, 6) = MatrixXd::Identity(3, 3) * _dt;
-        F.block<3, 3>(0, 9) = -0.25 * (delta_q.toRotationMatrix() + result_delta_q.toRotationMatrix()) * _dt * _dt;
-        F.block<3, 3>(0, 12) = -0.25 * result_delta_q.toRotationMatrix() * R_a_1_x * _dt * _dt * -_dt;
-        F.block<3, 3>(3, 3) = Matrix3d::Identity() - R_w_x * _dt;
-        F.block<3, 3>(3, 12) = -1.0 * MatrixXd::Identity(3, 3) * _dt;
-        F.block<3, 3>(6, 3) = -0.5 * delta_q.toRotationMatrix() * R_a_0_x * _dt +
-                              -0.5 * result_delta_q.toRotationMatrix() * R_a_1_x * (Matrix3d::Identity() - R_w_x * _dt) * _dt;
-        F.block<3, 3>(6, 6) = Matrix3d::Identity();
-        F.block<3, 3>(6, 9) = -0.5 * (delta_q.toRotationMatrix() + result_delta_q.toRotationMatrix()) * _dt;
-        F.block<3, 3>(6, 12) = -0.5 * result_delta_q.toRotationMatrix() * R_a_1_x * _dt * -_dt;
-        F.block<3, 3>(9, 9) = Matrix3d::Identity();
-        F.block<3, 3>(12, 12) = Matrix3d::Identity();
+        // F is identity except the rows of p, q and v, so only these rows are updated
+        Matrix3d R_0 = delta_q.toRotationMatrix();
+        Matrix3d R_1 = result_delta_q.toRotationMatrix();
+        Matrix3d R_1_a_1_x = R_1 * R_a_1_x;
+        Matrix3d F_v_q = -0.5 * R_0 * R_a_0_x * _dt - 0.5 * R_1_a_1_x * (Matrix3d::Identity() - R_w_x * _dt) * _dt;
+        Matrix3d F_v_ba = -0.5 * (R_0 + R_1) * _dt;
+        Matrix3d F_v_bg = 0.5 * R_1_a_1_x * _dt * _dt;
+        Matrix3d F_q_q = Matrix3d::Identity() - R_w_x * _dt;
+        // F_p_x = 0.5 * F_v_x * _dt
+        auto F_mul = [&](Matrix<double, 15, 15> &X) {
+            Matrix<double, 3, 15> X_q = X.middleRows<3>(3);
+            X.middleRows<3>(0) += 0.5 * _dt * (F_v_q * X_q + F_v_ba * X.middleRows<3>(9) + F_v_bg * X.middleRows<3>(12)) + _dt * X.middleRows<3>(6);
+            X.middleRows<3>(6) += F_v_q * X_q + F_v_ba * X.middleRows<3>(9) + F_v_bg * X.middleRows<3>(12);
+            X.middleRows<3>(3) = F_q_q * X_q - _dt * X.middleRows<3>(12);
+        };
+        F_mul(jacobian);
+        // covariance = F * covariance * F^T
+        F_mul(covariance);
+        covariance.transposeInPlace();
+        F_mul(covariance);
 
-        MatrixXd V = MatrixXd::Zero(15, 18);
-        V.block<3, 3>(0, 0) = 0.25 * delta_q.toRotationMatrix() * _dt * _dt;
-        V.block<3, 3>(0, 3) = 0.25 * -result_delta_q.toRotationMatrix() * R_a_1_x * _dt * _dt * 0.5 * _dt;
-        V.block<3, 3>(0, 6) = 0.25 * result_delta_q.toRotationMatrix() * _dt * _dt;
-        V.block<3, 3>(0, 9) = V.block<3, 3>(0, 3);
-        V.block<3, 3>(3, 3) = 0.5 * MatrixXd::Identity(3, 3) * _dt;
-        V.block<3, 3>(3, 9) = 0.5 * MatrixXd::Identity(3, 3) * _dt;
-        V.block<3, 3>(6, 0) = 0.5 * delta_q.toRotationMatrix() * _dt;
-        V.block<3, 3>(6, 3) = 0.5 * -result_delta_q.toRotationMatrix() * R_a_1_x * _dt * 0.5 * _dt;
-        V.block<3, 3>(6, 6) = 0.5 * result_delta_q.toRotationMatrix() * _dt;
-        V.block<3, 3>(6, 9) = V.block<3, 3>(6, 3);
-        V.block<3, 3>(9, 12) = MatrixXd::Identity(3, 3) * _dt;
-        V.block<3, 3>(12, 15) = MatrixXd::Identity(3, 3) * _dt;
-
-        jacobian = F * jacobian;
-        covariance = F * covariance * F.transpose() + V * noise * V.transpose();
+        // V * noise * V^T, noises of measurements are isotropic, and R * R^T = I
+        double dt2 = _dt * _dt, dt3 = dt2 * _dt, dt4 = dt3 * _dt;
+        Vector3d a_1 = R_1 * a_1_x;
+        Matrix3d A = a_1.squaredNorm() * Matrix3d::Identity() - a_1 * a_1.transpose(); // R_1_a_1_x * R_1_a_1_x^T
+        double n_a = noise(0), n_g = noise(1);
+        covariance.block<3, 3>(0, 0).diagonal().array() += n_a * dt4 / 8;
+        covariance.block<3, 3>(0, 0) += n_g * dt4 * dt2 / 32 * A;
+        covariance.block<3, 3>(0, 3) -= n_g * dt4 / 8 * R_1_a_1_x;
+        covariance.block<3, 3>(3, 0) -= n_g * dt4 / 8 * R_1_a_1_x.transpose();
+        covariance.block<3, 3>(0, 6).diagonal().array() += n_a * dt3 / 4;
+        covariance.block<3, 3>(0, 6) += n_g * dt4 * _dt / 16 * A;
+        covariance.block<3, 3>(6, 0).diagonal().array() += n_a * dt3 / 4;
+        covariance.block<3, 3>(6, 0) += n_g * dt4 * _dt / 16 * A;
+        covariance.block<3, 3>(3, 3).diagonal().array() += n_g * dt2 / 2;
+        covariance.block<3, 3>(3, 6) -= n_g * dt3 / 4 * R_1_a_1_x.transpose();
+        covariance.block<3, 3>(6, 3) -= n_g * dt3 / 4 * R_1_a_1_x;
+        covariance.block<3, 3>(6, 6).diagonal().array() += n_a * dt2 / 2;
+        covariance.block<3, 3>(6, 6) += n_g * dt4 / 8 * A;
+        covariance.block<3, 3>(9, 9).diagonal().array() += noise(2) * dt2;
+        covariance.block<3, 3>(12, 12).diagonal().array() += noise(3) * dt2;
     }
 }
 
 void Preintegration::Propagate(double _dt, const Vector3d &_acc_1, const Vector3d &_gyr_1)
 {
+    std::atomic_store(&sqrt_info_, std::shared_ptr<const SqrtInformation>());
     dt = _dt;
     acc1 = _acc_1;
     gyr1 = _gyr_1;
@@ -137,6 +141,7 @@ void Preintegration::Repropagate(const Vector3d &_linearized_ba, const Vector3d
     linearized_bg = _linearized_bg;
     jacobian.setIdentity();
     covariance.setZero();
+    std::atomic_store(&sqrt_info_, std::shared_ptr<const SqrtInformation>());
     for (int i = 0; i < static_cast<int>(dt_buf.size()); i++)
         Propagate(dt_buf[i], acc_buf[i], gyr_buf[i]);
 }
@@ -187,6 +192,38 @@ Matrix<double, 15, 1> Preintegration::Evaluate(
     return residuals;
 }
 
+Matrix<double, 15, 15> Preintegration::GetSqrtInformation()
+{
+    return GetSqrtInformation(false, 0, 0);
+}
+
+Matrix<double, 15, 15> Preintegration::GetSqrtInformation(double prior_a, double prior_g)
+{
+    return GetSqrtInformation(true, prior_a, prior_g);
+}
+
+Matrix<double, 15, 15> Preintegration::GetSqrtInformation(bool with_prior, double prior_a, double prior_g)
+{
+    auto sqrt_info = std::atomic_load(&sqrt_info_);
+    if (sqrt_info && sqrt_info->with_prior == with_prior &&
+        (!with_prior || (sqrt_info->prior_a == prior_a && sqrt_info->prior_g == prior_g)))
+        return sqrt_info->matrix;
+
+    auto new_sqrt_info = std::make_shared<SqrtInformation>();
+    new_sqrt_info->with_prior = with_prior;
+    new_sqrt_info->prior_a = prior_a;
+    new_sqrt_info->prior_g = prior_g;
+    Matrix<double, 15, 15> cov_inv = covariance.inverse();
+    if (with_prior)
+    {
+        cov_inv.block<3, 3>(9, 9) = prior_a * Matrix3d::Identity();
+        cov_inv.block<3, 3>(12, 12) = prior_g * Matrix3d::Identity();
+    }
+    new_sqrt_info->matrix = LLT<Matrix<double, 15, 15>>(cov_inv).matrixL().transpose();
+    std::atomic_store(&sqrt_info_, std::shared_ptr<const SqrtInformation>(new_sqrt_info));
+    return new_sqrt_info->matrix;
+}
+
 Vector3d Preintegration::GetUpdatedDeltaVelocity()
 {
     Matrix3d dv_dba = jacobian.block<3, 3>(O_V, O_BA);
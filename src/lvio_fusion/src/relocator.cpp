@@ -53,7 +53,7 @@ void Relocator::DetectorLoop()
                     last_frame = frame;
                 }
                 if (section != loop_section ||
-                    (Map::Instance().end && frame == (--Map::Instance().keyframes.end())->second))
+                    (Map::Instance().end && frame == Map::Instance().GetKeyFrame(-1)))
                 {
                     // new old section, new loop
                     LOG(INFO) << std::setiosflags(std::ios::fixed) << std::setprecision(5) << "1Detected new loop, and correct it now. old_time:" << old_time << ";start_time:" << start_time << ";end_time:" << last_frame->time;
@@ -89,7 +89,7 @@ bool Relocator::DetectLoop(Frame::Ptr frame, Frame::Ptr &old_frame)
     static double finished = 0;
     static PointICloud points;
     static std::unordered_map<int, double> map;
-    Frames active_kfs = Map::Instance().GetKeyFrames(finished, frame->time - 30);
+    FramesView active_kfs = Map::Instance().GetKeyFrames(finished, frame->time - 30);
     finished = frame->time - 30 + epsilon;
     for (auto pair : active_kfs)
     {
@@ -186,7 +186,7 @@ bool Relocator::RelocateByPoints(Frame::Ptr frame, Frame::Ptr old_frame)
 void Relocator::CorrectLoop(double old_time, double start_time, double end_time)
 {
     std::unique_lock<std::mutex> lock(backend_->mutex, std::defer_lock);
-    Frames new_submap_kfs = Map::Instance().GetKeyFrames(start_time, end_time);
+    FramesView new_submap_kfs = Map::Instance().GetKeyFrames(start_time, end_time);
 
     // update frames
     SE3d old_pose = (--new_submap_kfs.end())->second->pose;
@@ -236,7 +236,7 @@ void Relocator::CorrectLoop(double old_time, double start_time, double end_time)
     // update pointscloud
     if (Lidar::Num() && mapping_)
     {
-        Frames mapping_kfs = Map::Instance().GetKeyFrames(old_time);
+        FramesView mapping_kfs = Map::Instance().GetKeyFrames(old_time);
         for (auto &pair : mapping_kfs)
         {
             mapping_->ToWorld(pair.second);
@@ -244,7 +244,7 @@ void Relocator::CorrectLoop(double old_time, double start_time, double end_time)
     }
 }
 
-void Relocator::UpdateNewSubmap(Frame::Ptr best_frame, Frames &new_submap_kfs)
+void Relocator::UpdateNewSubmap(Frame::Ptr best_frame, const FramesView &new_submap_kfs)
 {
     // optimize the best frame's rotation
     SE3d old_pose = best_frame->pose;
@@ -0,0 +1,170 @@
+#include "lvio_fusion/visual/stereo.h"
+#include "lvio_fusion/utility.h"
+#include "lvio_fusion/visual/camera.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lvio_fusion
+{
+
+// patch of SAD is 16x9
+const int patch_half_width = 8;
+const int patch_half_height = 4;
+const int patch_area = (2 * patch_half_width) * (2 * patch_half_height + 1);
+
+/**
+ * SAD costs of disparities [0, max_d] on the scanline
+ * @param left      rectified left image, the patch centers at (x, y)
+ * @param right     rectified right image
+ * @param costs     costs of max_d + 1 disparities
+ */
+inline void sad_costs(const uchar *left, int left_step, const uchar *right, int right_step,
+                      int x, int y, int max_d, int *costs)
+{
+    const uchar *l = left + (y - patch_half_height) * left_step + x - patch_half_width;
+    const uchar *r = right + (y - patch_half_height) * right_step + x - patch_half_width;
+#if defined(__SSE2__)
+    __m128i rows[2 * patch_half_height + 1];
+    for (int j = 0; j <= 2 * patch_half_height; j++)
+    {
+        rows[j] = _mm_loadu_si128((const __m128i *)(l + j * left_step));
+    }
+    for (int d = 0; d <= max_d; d++)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int j = 0; j <= 2 * patch_half_height; j++)
+        {
+            sum = _mm_add_epi32(sum, _mm_sad_epu8(rows[j], _mm_loadu_si128((const __m128i *)(r + j * right_step - d))));
+        }
+        costs[d] = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+    }
+#else
+    for (int d = 0; d <= max_d; d++)
+    {
+        int cost = 0;
+        for (int j = 0; j <= 2 * patch_half_height; j++)
+        {
+            for (int i = 0; i < 2 * patch_half_width; i++)
+            {
+                cost += std::abs(l[j * left_step + i] - r[j * right_step + i - d]);
+            }
+        }
+        costs[d] = cost;
+    }
+#endif
+}
+
+/**
+ * find the disparity with the minimum cost, and refine it by a parabola
+ * @return  subpixel disparity, or 0 if not found
+ */
+inline double best_disparity(const int *costs, int max_d)
+{
+    // the mean absolute difference should be small
+    const int max_cost = 20 * patch_area;
+    const double uniqueness = 0.9;
+
+    int best = 0;
+    for (int d = 1; d <= max_d; d++)
+    {
+        if (costs[d] < costs[best])
+            best = d;
+    }
+    int second = INT_MAX;
+    for (int d = 0; d <= max_d; d++)
+    {
+        if (std::abs(d - best) > 1 && costs[d] < second)
+            second = costs[d];
+    }
+    if (best == 0 || best == max_d || costs[best] > max_cost || costs[best] >= uniqueness * second)
+        return 0;
+
+    double c0 = costs[best - 1], c1 = costs[best], c2 = costs[best + 1];
+    double denom = c0 - 2 * c1 + c2;
+    return denom > 0 ? best + 0.5 * (c0 - c2) / denom : best;
+}
+
+void StereoMatcher::Init(cv::Size size)
+{
+    size_ = size;
+    auto left = Camera::Get(0), right = Camera::Get(1);
+    // x_right = R * x_left + T
+    SE3d left_to_right = right->extrinsic.inverse() * left->extrinsic;
+    Matrix3d R_eigen = left_to_right.rotationMatrix();
+    Vector3d T_eigen = left_to_right.translation();
+    cv::Mat R, T, R_right, P_right, Q;
+    cv::eigen2cv(R_eigen, R);
+    cv::eigen2cv(T_eigen, T);
+    // images have been undistorted
+    cv::Mat D = cv::Mat::zeros(5, 1, CV_64F);
+    cv::stereoRectify(left->K, D, right->K, D, size, R, T, R_left_, R_right, P_left_, P_right, Q, cv::CALIB_ZERO_DISPARITY, 0);
+    cv::initUndistortRectifyMap(left->K, D, R_left_, P_left_, size, CV_16SC2, map_left_[0], map_left_[1]);
+    cv::initUndistortRectifyMap(right->K, D, R_right, P_right, size, CV_16SC2, map_right_[0], map_right_[1]);
+
+    f_ = P_left_.at<double>(0, 0);
+    cx_ = P_left_.at<double>(0, 2);
+    cy_ = P_left_.at<double>(1, 2);
+    bf_ = -P_right.at<double>(0, 3);
+    Matrix3d R_left;
+    cv::cv2eigen(R_left_, R_left);
+    R_left_inverse_ = R_left.transpose();
+    // the nearest point is two baselines away
+    max_disparity_ = std::min(size.width / 2, (int)(f_ / 2));
+    LOG(INFO) << "Stereo rectified, f: " << f_ << ", baseline: " << bf_ / f_ << ", max disparity: " << max_disparity_;
+}
+
+void StereoMatcher::Match(const cv::Mat &image_left, const cv::Mat &image_right,
+                          const std::vector<cv::Point2f> &kps_left, std::vector<cv::Point2f> &kps_right,
+                          std::vector<Vector3d> &pbs, std::vector<uchar> &status)
+{
+    const int n = kps_left.size();
+    kps_right.resize(n);
+    pbs.resize(n);
+    status.assign(n, 0);
+    if (n == 0)
+        return;
+    if (size_ != image_left.size())
+    {
+        Init(image_left.size());
+    }
+    if (bf_ <= 0)
+        return;
+
+    cv::Mat rect_left, rect_right;
+    cv::remap(image_left, rect_left, map_left_[0], map_left_[1], cv::INTER_LINEAR);
+    cv::remap(image_right, rect_right, map_right_[0], map_right_[1], cv::INTER_LINEAR);
+    std::vector<cv::Point2f> rect_pts;
+    cv::undistortPoints(kps_left, rect_pts, Camera::Get(0)->K, cv::Mat(), R_left_, P_left_);
+
+    // each batch of points shares one buffer
+    const int batch = 64;
+    parallel_for((n + batch - 1) / batch, [&](int k) {
+        std::vector<int> costs(max_disparity_ + 1);
+        for (int i = k * batch; i < std::min(n, (k + 1) * batch); i++)
+        {
+            int x = cvRound(rect_pts[i].x), y = cvRound(rect_pts[i].y);
+            if (x < patch_half_width || x + patch_half_width > rect_left.cols ||
+                y < patch_half_height || y + patch_half_height >= rect_left.rows)
+                continue;
+
+            int max_d = std::min(max_disparity_, x - patch_half_width);
+            if (max_d < 2)
+                continue;
+            sad_costs(rect_left.data, (int)rect_left.step, rect_right.data, (int)rect_right.step, x, y, max_d, costs.data());
+            // the disparity of the patch is also the one of the exact point in it
+            double d = best_disparity(costs.data(), max_d);
+            if (d <= 0)
+                continue;
+
+            double z = bf_ / d;
+            Vector3d pr((rect_pts[i].x - cx_) * z / f_, (rect_pts[i].y - cy_) * z / f_, z);
+            pbs[i] = Camera::Get(0)->Sensor2Robot(R_left_inverse_ * pr);
+            kps_right[i] = eigen2cv(Camera::Get(1)->Robot2Pixel(pbs[i]));
+            status[i] = 1;
+        }
+    });
+}
+
+} // namespace lvio_fusion
@@ -9,7 +9,7 @@ namespace lvio_fusion
 namespace imu
 {
 
-void RePredictVel(Frames &frames, Frame::Ptr &prior_frame)
+void RePredictVel(const Frames &frames, Frame::Ptr &prior_frame)
 {
     Frame::Ptr last_frame = prior_frame;
     Vector3d G(0, 0, -Imu::Get()->G);
@@ -31,7 +31,7 @@ void RePredictVel(Frames &frames, Frame::Ptr &prior_frame)
     }
 }
 
-bool InertialOptimization(Frames &frames, Matrix3d &Rwg, double prior_a, double prior_g)
+bool InertialOptimization(const FramesView &frames, Matrix3d &Rwg, double prior_a, double prior_g)
 {
     ceres::Problem problem;
     ceres::CostFunction *cost_function;
@@ -90,7 +90,7 @@ bool InertialOptimization(Frames &frames, Matrix3d &Rwg, double prior_a, double
     return true;
 }
 
-void FullBA(Frames &frames, double prior_a, double prior_g)
+void FullBA(const FramesView &frames, double prior_a, double prior_g)
 {
     ceres::Problem problem;
     ceres::CostFunction *cost_function;
@@ -172,7 +172,7 @@ void FullBA(Frames &frames, double prior_a, double prior_g)
     RecoverBias(frames);
 }
 
-void RecoverBias(Frames &frames)
+void RecoverBias(const FramesView &frames)
 {
     for (auto &pair : frames)
     {
@@ -4,6 +4,30 @@
 namespace lvio_fusion
 {
 
+class ParallelInvoker : public cv::ParallelLoopBody
+{
+public:
+    ParallelInvoker(const std::function<void(int)> &body) : body_(body) {}
+
+    void operator()(const cv::Range &range) const override
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            body_(i);
+        }
+    }
+
+private:
+    const std::function<void(int)> &body_;
+};
+
+void parallel_for(int n, const std::function<void(int)> &body)
+{
+    if (n <= 0)
+        return;
+    cv::parallel_for_(cv::Range(0, n), ParallelInvoker(body));
+}
+
 void triangulate(const SE3d &pose0, const SE3d &pose1, const Vector3d &p0, const Vector3d &p1, Vector3d &p_3d)
 {
     Matrix4d A = Matrix4d::Zero();
@@ -17,6 +41,30 @@ void triangulate(const SE3d &pose0, const SE3d &pose1, const Vector3d &p0, const
     p_3d = (p_norm / p_norm(3)).head<3>();
 }
 
+void triangulate(const SE3d &pose0, const SE3d &pose1,
+                 const ArrayXd &x0, const ArrayXd &y0, const ArrayXd &x1, const ArrayXd &y1,
+                 ArrayXd &depths)
+{
+    // in view 0, ray a = (x0, y0, 1) meets ray o + t * b, b = R^T * (x1, y1, 1)
+    SE3d relative = pose1 * pose0.inverse();
+    Matrix3d R = relative.rotationMatrix().transpose();
+    Vector3d o = -R * relative.translation();
+    ArrayXd bx = R(0, 0) * x1 + R(0, 1) * y1 + R(0, 2);
+    ArrayXd by = R(1, 0) * x1 + R(1, 1) * y1 + R(1, 2);
+    ArrayXd bz = R(2, 0) * x1 + R(2, 1) * y1 + R(2, 2);
+
+    // normal equations of min |s * a - o - t * b|
+    ArrayXd A = x0.square() + y0.square() + 1;
+    ArrayXd B = x0 * bx + y0 * by + bz;
+    ArrayXd C = bx.square() + by.square() + bz.square();
+    ArrayXd d = x0 * o.x() + y0 * o.y() + o.z();
+    ArrayXd e = bx * o.x() + by * o.y() + bz * o.z();
+    ArrayXd det = A * C - B.square();
+    ArrayXd s = (C * d - B * e) / det;
+    ArrayXd t = (B * d - A * e) / det;
+    depths = (det > 1e-12 * A * C).select(0.5 * (s + o.z() + t * bz), 0);
+}
+
 double cv_distance(cv::Point2f &pt1, cv::Point2f &pt2)
 {
     double dx = pt1.x - pt2.x;
@@ -52,7 +100,7 @@ SE3d get_pose_from_two_points(const Vector3d &a, const Vector3d &b)
     return rpyxyz2se3(rpyxyz);
 }
 
-void optical_flow(cv::Mat &prevImg, cv::Mat &nextImg,
+inline void optical_flow(cv::InputArray prevImg, cv::InputArray nextImg, cv::Size size,
                   std::vector<cv::Point2f> &prevPts, std::vector<cv::Point2f> &nextPts,
                   std::vector<uchar> &status)
 {
@@ -74,8 +122,8 @@ void optical_flow(cv::Mat &prevImg, cv::Mat &nextImg,
     {
         if (status[i] && reverse_status[i] &&
             cv_distance(prevPts[i], reverse_pts[i]) <= 0.5 &&
-            nextPts[i].x >= 0 && nextPts[i].x < prevImg.cols &&
-            nextPts[i].y >= 0 && nextPts[i].y < prevImg.rows)
+            nextPts[i].x >= 0 && nextPts[i].x < size.width &&
+            nextPts[i].y >= 0 && nextPts[i].y < size.height)
         {
             status[i] = 1;
             num_success_pts++;
@@ -85,6 +133,25 @@ void optical_flow(cv::Mat &prevImg, cv::Mat &nextImg,
     }
 }
 
+void optical_flow(cv::Mat &prevImg, cv::Mat &nextImg,
+                  std::vector<cv::Point2f> &prevPts, std::vector<cv::Point2f> &nextPts,
+                  std::vector<uchar> &status)
+{
+    optical_flow(prevImg, nextImg, prevImg.size(), prevPts, nextPts, status);
+}
+
+void optical_flow(const std::vector<cv::Mat> &prevPyr, const std::vector<cv::Mat> &nextPyr,
+                  std::vector<cv::Point2f> &prevPts, std::vector<cv::Point2f> &nextPts,
+                  std::vector<uchar> &status)
+{
+    optical_flow(prevPyr, nextPyr, prevPyr[0].size(), prevPts, nextPts, status);
+}
+
+void build_optical_flow_pyramid(const cv::Mat &img, std::vector<cv::Mat> &pyramid)
+{
+    cv::buildOpticalFlowPyramid(img, pyramid, cv::Size(21, 21), 3, true);
+}
+
 Vector3d R2ypr(const Matrix3d &R)
 {
     Vector3d n = R.col(0);
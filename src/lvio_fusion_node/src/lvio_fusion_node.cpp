@@ -91,7 +91,6 @@ cv::Mat get_image_from_msg(const sensor_msgs::ImageConstPtr &img_msg)
         image = ptr->image.clone();
     }
 
-    cv::equalizeHist(image, image);
     return image;
 }
 
@@ -298,7 +297,7 @@ void write_result(Estimator::Ptr estimator)
     ofstream out(result_path, ios::out);
     out.setf(ios::fixed, ios::floatfield);
     out.precision(5);
-    for (auto &pair : lvio_fusion::Map::Instance().keyframes)
+    for (auto &pair : lvio_fusion::Map::Instance().GetKeyFrames(0))
     {
         out << pair.first - init_time << ",";
         SE3d pose = pair.second->pose;
@@ -323,7 +322,7 @@ void read_ground_truth()
     string line;
     stringstream ss;
     double time, x, y, z, qx, qy, qz, qw;
-    double dt = lvio_fusion::Map::Instance().keyframes.begin()->first;
+    double dt = lvio_fusion::Map::Instance().GetKeyFrames(0).begin()->first;
     Matrix3d R_tf;
     R_tf << 0, 0, 1,
         -1, 0, 0,
@@ -386,7 +385,7 @@ void keyboard_process()
             break;
         case 'e':
         {
-            double end_time = (--lvio_fusion::Map::Instance().keyframes.end())->first;
+            double end_time = lvio_fusion::Map::Instance().GetKeyFrame(-1)->time;
             lvio_fusion::Map::Instance().end = true;
             estimator->backend->UpdateMap();
         }
@@ -36,7 +36,7 @@ void publish_odometry(Estimator::Ptr estimator, double time)
     submap[PoseGraph::Instance().current_section.A] = PoseGraph::Instance().current_section;
     path.poses.clear();
     cameraposevisual.reset();
-    for (auto &pair : lvio_fusion::Map::Instance().keyframes)
+    for (auto &pair : lvio_fusion::Map::Instance().GetKeyFrames(0))
     {
         auto pose = pair.second->pose;
         geometry_msgs::PoseStamped pose_stamped;
@@ -121,9 +121,19 @@ void publish_tf(Estimator::Ptr estimator, double time)
     tf::Quaternion tf_q;
     tf::Vector3 tf_t;
     // base_link
-    if (estimator->frontend->status == FrontendStatus::TRACKING)
+    // the frontend thread replaces current_frame, copy the pose under its mutex
+    bool tracking = false;
+    SE3d pose;
+    {
+        std::unique_lock<std::mutex> lock(estimator->frontend->mutex);
+        if (estimator->frontend->status == FrontendStatus::TRACKING && estimator->frontend->current_frame)
+        {
+            tracking = true;
+            pose = estimator->frontend->current_frame->pose;
+        }
+    }
+    if (tracking)
     {
-        SE3d pose = estimator->frontend->current_frame->pose;
         Quaterniond pose_q = pose.unit_quaternion();
         Vector3d pose_t = pose.translation();
         tf_q.setValue(pose_q.w(), pose_q.x(), pose_q.y(), pose_q.z());
@@ -173,7 +183,13 @@ void publish_car_model(Estimator::Ptr estimator, double time)
     car_mesh.mesh_resource = "file:///home/jyp/Projects/lvio_fusion/src/lvio_fusion_node/models/car.dae";
     car_mesh.id = 0;
 
-    SE3d pose = estimator->frontend->current_frame->pose;
+    SE3d pose;
+    {
+        std::unique_lock<std::mutex> lock(estimator->frontend->mutex);
+        if (!estimator->frontend->current_frame)
+            return;
+        pose = estimator->frontend->current_frame->pose;
+    }
     Matrix3d rotate;
     rotate << -1, 0, 0, 0, 0, 1, 0, 1, 0;
     Quaterniond Q;